@@ -0,0 +1,96 @@
+// Runs the layout regression cases, then the fuzz harness on seeded random
+// inputs. Builds with any compiler, no libFuzzer needed.
+#include "Layout.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace {
+	int failures = 0;
+
+	void expect(const bool ok, const char *what)
+	{
+		if (!ok) {
+			fprintf(stderr, "check: %s\n", what);
+			failures++;
+		}
+	}
+
+	// Bounds of an outline entirely below zero keep their negative maximum
+	void negative_outline_bounds()
+	{
+		const float xs[] = { -3.0f, -2.0f, -1.0f };
+		const float ys[] = { -5.0f, -4.0f, -6.0f };
+		hreeble::OutlineBounds bounds = hreeble::outline_bounds(xs, ys, 3);
+		expect(bounds.min[0] == -3.0f && bounds.max[0] == -1.0f, "bounds of a negative outline along x");
+		expect(bounds.min[1] == -6.0f && bounds.max[1] == -4.0f, "bounds of a negative outline along y");
+	}
+
+	// Faces other than quads are left alone, their corners are never read past
+	void non_quad_split()
+	{
+		for (int num_vtx = 0; num_vtx < 8; num_vtx++) {
+			if (num_vtx == 4)
+				continue;
+			std::unique_ptr<float[]> corners(new float[num_vtx * 3]);
+			for (int i = 0; i < num_vtx * 3; i++)
+				corners[i] = float(i);
+			float first[3], second[3];
+			for (int dir = 0; dir < 2; dir++)
+				expect(!hreeble::quad_split_points(corners.get(), num_vtx, dir, first, second), "split of a face that isn't a quad");
+		}
+		const float quad[] = { 0, 0, 0,  0, 0, 2,  2, 0, 2,  2, 0, 0 };
+		float first[3], second[3];
+		expect(hreeble::quad_split_points(quad, 4, 0, first, second), "split of a quad");
+		expect(first[0] == 1.0f && first[2] == 2.0f && second[0] == 1.0f && second[2] == 0.0f, "split points of a quad");
+	}
+
+	// An outline too big for its face is fitted in, and the instance transform
+	// still lands every point where the polygons are built
+	void oversized_outline()
+	{
+		const float xs[] = { 0.0f, 0.0f, 1.0f, 1.0f };
+		const float ys[] = { 0.0f, 1.0f, 1.0f, 0.0f };
+		float px[4], py[4];
+		for (int i = 0; i < 4; i++) {
+			px[i] = xs[i];
+			py[i] = ys[i];
+		}
+		const double target[2] = { 0.9, 0.2 };
+		hreeble::OutlineXform xform = { { 1.0, 1.0 }, { 0.0, 0.0 } };
+		hreeble::place_outline(px, py, 4, target, 1.5, xform);
+		for (int i = 0; i < 4; i++) {
+			expect(px[i] >= 0.0f && px[i] <= 1.0f && py[i] >= 0.0f && py[i] <= 1.0f, "oversized outline left outside its face");
+			expect(std::fabs(xs[i] * xform.scale[0] + xform.origin[0] - px[i]) < 1e-5
+				   && std::fabs(ys[i] * xform.scale[1] + xform.origin[1] - py[i]) < 1e-5, "instance transform of a fitted outline");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	negative_outline_bounds();
+	non_quad_split();
+	oversized_outline();
+
+	int runs = argc > 1 ? atoi(argv[1]) : 100000;
+	std::mt19937 rng(1);
+	std::vector<uint8_t> input;
+	for (int run = 0; run < runs; run++) {
+		input.resize(rng() % 512);
+		for (auto &byte : input)
+			byte = uint8_t(rng());
+		LLVMFuzzerTestOneInput(input.data(), input.size());
+	}
+	if (failures != 0) {
+		fprintf(stderr, "check: %d failed\n", failures);
+		return 1;
+	}
+	printf("check: regression cases and %d random inputs passed\n", runs);
+	return 0;
+}
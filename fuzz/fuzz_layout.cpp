@@ -0,0 +1,163 @@
+// libFuzzer harness for the layout kernels: every input is decoded into an
+// outline, a quad split and an extrude ring, and the kernels are checked
+// against reference.h and the invariants generation relies on.
+#include "Layout.h"
+#include "reference.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace {
+	// Draws bounded values from the fuzz input, zeros once it's used up
+	class Reader
+	{
+	public:
+		Reader(const uint8_t *data, size_t size) :data(data), size(size) {}
+		uint32_t next_uint()
+		{
+			uint32_t value = 0;
+			size_t bytes = size < sizeof(value) ? size : sizeof(value);
+			if (bytes == 0)
+				return 0;
+			memcpy(&value, data, bytes);
+			data += bytes;
+			size -= bytes;
+			return value;
+		}
+		int next_int(const int count) { return int(next_uint() % uint32_t(count)); }
+		float next_float(const float lo, const float hi) { return lo + (hi - lo) * float(next_uint() / 4294967295.0); }
+
+	private:
+		const uint8_t *data;
+		size_t size;
+	};
+
+	void fail(const char *what, const double got, const double expected)
+	{
+		fprintf(stderr, "fuzz_layout: %s is %.9g, expected %.9g\n", what, got, expected);
+		abort();
+	}
+
+	void check_close(const char *what, const double got, const double expected, const double tolerance)
+	{
+		if (!(std::fabs(got - expected) <= tolerance * (1.0 + std::fabs(expected))))
+			fail(what, got, expected);
+	}
+
+	void check_outline(Reader &in)
+	{
+		const int64_t num = 1 + in.next_int(24);
+		std::unique_ptr<float[]> xs(new float[num]), ys(new float[num]);
+		for (int64_t i = 0; i < num; i++) {
+			xs[i] = in.next_float(-1.5f, 2.5f);
+			ys[i] = in.next_float(-1.5f, 2.5f);
+		}
+		hreeble::OutlineBounds bounds = hreeble::outline_bounds(xs.get(), ys.get(), num);
+		reference::Bounds ref_bounds = reference::bounds(xs.get(), ys.get(), num);
+		for (int axis = 0; axis < 2; axis++) {
+			if (bounds.min[axis] != ref_bounds.min[axis])
+				fail("bounds min", bounds.min[axis], ref_bounds.min[axis]);
+			if (bounds.max[axis] != ref_bounds.max[axis])
+				fail("bounds max", bounds.max[axis], ref_bounds.max[axis]);
+		}
+		double pivot[2], ref_pivot[2], offset[2], ref_offset[2];
+		hreeble::outline_pivot(xs.get(), ys.get(), num, pivot);
+		reference::pivot(xs.get(), ys.get(), num, ref_pivot);
+		hreeble::bounds_offset(xs.get(), ys.get(), num, offset);
+		reference::bounds_offset(xs.get(), ys.get(), num, ref_offset);
+		for (int axis = 0; axis < 2; axis++) {
+			check_close("pivot", pivot[axis], ref_pivot[axis], 1e-12);
+			check_close("bounds offset", offset[axis], ref_offset[axis], 1e-12);
+		}
+
+		const double target[2] = { in.next_float(-0.5f, 1.5f), in.next_float(-0.5f, 1.5f) };
+		const double scale = in.next_float(0.05f, 3.0f);
+		std::unique_ptr<float[]> px(new float[num]), py(new float[num]), rx(new float[num]), ry(new float[num]);
+		memcpy(px.get(), xs.get(), num * sizeof(float));
+		memcpy(py.get(), ys.get(), num * sizeof(float));
+		memcpy(rx.get(), xs.get(), num * sizeof(float));
+		memcpy(ry.get(), ys.get(), num * sizeof(float));
+		hreeble::OutlineXform xform = { { 1.0, 1.0 }, { 0.0, 0.0 } };
+		hreeble::place_outline(px.get(), py.get(), num, target, scale, xform);
+		double ref_scale[2] = { 1.0, 1.0 }, ref_origin[2] = { 0.0, 0.0 };
+		reference::place(rx.get(), ry.get(), num, target, scale, ref_scale, ref_origin);
+		for (int axis = 0; axis < 2; axis++) {
+			check_close("xform scale", xform.scale[axis], ref_scale[axis], 1e-6);
+			check_close("xform origin", xform.origin[axis], ref_origin[axis], 1e-5);
+		}
+		for (int64_t i = 0; i < num; i++) {
+			check_close("placed x", px[i], rx[i], 1e-5);
+			check_close("placed y", py[i], ry[i], 1e-5);
+			// Elements end up inside their face
+			if (px[i] < -1e-5f || px[i] > 1.0f + 1e-5f)
+				fail("placed x outside the face", px[i], 0.5);
+			if (py[i] < -1e-5f || py[i] > 1.0f + 1e-5f)
+				fail("placed y outside the face", py[i], 0.5);
+			// and the instance transform describes the same outline
+			check_close("instanced x", xs[i] * xform.scale[0] + xform.origin[0], px[i], 1e-4);
+			check_close("instanced y", ys[i] * xform.scale[1] + xform.origin[1], py[i], 1e-4);
+		}
+	}
+
+	void check_quad_split(Reader &in)
+	{
+		// Exactly as many corners as the face has, reading past them is caught
+		const int64_t num_vtx = in.next_int(8);
+		const int dir = in.next_int(2);
+		std::unique_ptr<float[]> corners(new float[num_vtx * 3]);
+		for (int64_t i = 0; i < num_vtx * 3; i++)
+			corners[i] = in.next_float(-100.0f, 100.0f);
+		float first[3], second[3];
+		bool split = hreeble::quad_split_points(corners.get(), num_vtx, dir, first, second);
+		if (split != (num_vtx == 4))
+			fail("quad split of a face with that many corners", split, num_vtx == 4);
+		if (!split)
+			return;
+		const int edges[2][4] = { { 1, 2, 0, 3 }, { 0, 1, 3, 2 } };
+		float ref_first[3], ref_second[3];
+		reference::midpoint(&corners[edges[dir][0] * 3], &corners[edges[dir][1] * 3], ref_first);
+		reference::midpoint(&corners[edges[dir][2] * 3], &corners[edges[dir][3] * 3], ref_second);
+		for (int c = 0; c < 3; c++) {
+			check_close("first split point", first[c], ref_first[c], 1e-5);
+			check_close("second split point", second[c], ref_second[c], 1e-5);
+		}
+	}
+
+	void check_inset_ring(Reader &in)
+	{
+		const int64_t num = 1 + in.next_int(8);
+		std::unique_ptr<float[]> base(new float[num * 3]), top(new float[num * 3]), dirs(new float[num * 3]);
+		std::unique_ptr<float[]> ref_top(new float[num * 3]), ref_dirs(new float[num * 3]);
+		for (int64_t i = 0; i < num * 3; i++)
+			base[i] = in.next_float(-10.0f, 10.0f);
+		float n[3], center[3];
+		for (int c = 0; c < 3; c++) {
+			n[c] = in.next_float(-1.0f, 1.0f);
+			center[c] = in.next_float(-10.0f, 10.0f);
+		}
+		const double height = in.next_float(0.0f, 2.0f);
+		const double inset = in.next_float(0.0f, 1.0f);
+		const double max_size = in.next_float(0.0f, 1.0f);
+		double size = hreeble::inset_ring(base.get(), num, n, center, height, inset, max_size, top.get(), dirs.get());
+		double ref_size = max_size;
+		reference::inset_ring(base.get(), num, n, center, height, inset, ref_size, ref_top.get(), ref_dirs.get());
+		check_close("bevel size", size, ref_size, 1e-5);
+		if (size < 0.0 || size > max_size)
+			fail("bevel size out of range", size, max_size);
+		for (int64_t i = 0; i < num * 3; i++) {
+			check_close("ring point", top[i], ref_top[i], 1e-5);
+			check_close("inset direction", dirs[i], ref_dirs[i], 1e-5);
+		}
+	}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	Reader in(data, size);
+	check_outline(in);
+	check_quad_split(in);
+	check_inset_ring(in);
+	return 0;
+}
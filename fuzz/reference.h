@@ -0,0 +1,127 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// Straightforward versions of the kernels in Layout.cpp, one point and one
+// step at a time, for the harness to compare against.
+namespace reference {
+	struct Bounds
+	{
+		float min[2];
+		float max[2];
+	};
+
+	inline Bounds bounds(const float *xs, const float *ys, const int64_t num)
+	{
+		Bounds b = { { xs[0], ys[0] }, { xs[0], ys[0] } };
+		for (int64_t i = 0; i < num; i++) {
+			if (xs[i] < b.min[0]) b.min[0] = xs[i];
+			if (xs[i] > b.max[0]) b.max[0] = xs[i];
+			if (ys[i] < b.min[1]) b.min[1] = ys[i];
+			if (ys[i] > b.max[1]) b.max[1] = ys[i];
+		}
+		return b;
+	}
+
+	inline void pivot(const float *xs, const float *ys, const int64_t num, double *p)
+	{
+		p[0] = 0.0;
+		p[1] = 0.0;
+		for (int64_t i = 0; i < num; i++) {
+			p[0] += xs[i];
+			p[1] += ys[i];
+		}
+		p[0] /= num;
+		p[1] /= num;
+	}
+
+	// A bound below 0 moves up to 0, one above 1 down to 1, both add up
+	inline void bounds_offset(const float *xs, const float *ys, const int64_t num, double *offset)
+	{
+		Bounds b = bounds(xs, ys, num);
+		for (int axis = 0; axis < 2; axis++) {
+			offset[axis] = 0.0;
+			const double ends[2] = { b.min[axis], b.max[axis] };
+			for (double end : ends) {
+				if (end < 0.0)
+					offset[axis] += -end;
+				else if (end > 1.0)
+					offset[axis] += 1.0 - end;
+			}
+		}
+	}
+
+	inline void place(float *xs, float *ys, const int64_t num, const double *target, const double scale, double *xscale, double *origin)
+	{
+		double p[2];
+		pivot(xs, ys, num, p);
+		const double move[2] = { target[0] - p[0], target[1] - p[1] };
+		for (int64_t i = 0; i < num; i++) {
+			xs[i] = xs[i] + float(move[0]);
+			ys[i] = ys[i] + float(move[1]);
+		}
+		pivot(xs, ys, num, p);
+		for (int64_t i = 0; i < num; i++) {
+			xs[i] = xs[i] + (xs[i] - float(p[0])) * float(scale - 1);
+			ys[i] = ys[i] + (ys[i] - float(p[1])) * float(scale - 1);
+		}
+		for (int axis = 0; axis < 2; axis++) {
+			origin[axis] = origin[axis] + move[axis];
+			origin[axis] = p[axis] + (origin[axis] - p[axis]) * scale;
+			xscale[axis] = xscale[axis] * scale;
+		}
+		double offset[2];
+		bounds_offset(xs, ys, num, offset);
+		if (offset[0] != 0.0 || offset[1] != 0.0) {
+			for (int64_t i = 0; i < num; i++) {
+				xs[i] = xs[i] + float(offset[0] * 1.2);
+				ys[i] = ys[i] + float(offset[1] * 1.2);
+			}
+			origin[0] += offset[0] * 1.2;
+			origin[1] += offset[1] * 1.2;
+		}
+		bounds_offset(xs, ys, num, offset);
+		if (offset[0] == 0.0 && offset[1] == 0.0)
+			return;
+		Bounds b = bounds(xs, ys, num);
+		for (int axis = 0; axis < 2; axis++) {
+			float lo = b.min[axis], hi = b.max[axis];
+			float fit_lo = lo < 0.01f ? 0.01f : (lo > 0.99f ? 0.99f : lo);
+			float fit_hi = hi < 0.01f ? 0.01f : (hi > 0.99f ? 0.99f : hi);
+			float k = hi > lo ? (fit_hi - fit_lo) / (hi - lo) : 1.0f;
+			float *values = axis == 0 ? xs : ys;
+			for (int64_t i = 0; i < num; i++)
+				values[i] = fit_lo + (values[i] - lo) * k;
+			origin[axis] = fit_lo + (origin[axis] - lo) * k;
+			xscale[axis] = xscale[axis] * k;
+		}
+	}
+
+	inline void midpoint(const float *a, const float *b, float *mid)
+	{
+		for (int c = 0; c < 3; c++)
+			mid[c] = (a[c] + b[c]) * 0.5f;
+	}
+
+	inline void inset_ring(const float *base, const int64_t num, const float *n, const float *center, const double height,
+						   const double inset, double &size, float *top, float *dirs)
+	{
+		for (int64_t i = 0; i < num; i++) {
+			float lifted[3], to_center[3];
+			for (int c = 0; c < 3; c++) {
+				lifted[c] = base[i * 3 + c] + n[c] * float(height);
+				to_center[c] = center[c] - lifted[c];
+			}
+			float length = std::sqrt(to_center[0] * to_center[0] + to_center[1] * to_center[1] + to_center[2] * to_center[2]);
+			double room = (length - inset) * 0.5;
+			if (room < 0.0)
+				room = 0.0;
+			if (room < size)
+				size = room;
+			for (int c = 0; c < 3; c++) {
+				dirs[i * 3 + c] = length > 0.0f ? to_center[c] / length : to_center[c];
+				top[i * 3 + c] = lifted[c] + dirs[i * 3 + c] * float(inset);
+			}
+		}
+	}
+}
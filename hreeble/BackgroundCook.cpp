@@ -0,0 +1,69 @@
+#include "BackgroundCook.h"
+
+// Marks the source faces in the private copy, destroyed once generation is done
+static const char *const SOURCE_GROUP = "__hreeble_background_source";
+
+BackgroundCook::BackgroundCook()
+	:started(false), done(false), job_result(GeneratorResult::DONE)
+{
+}
+
+
+BackgroundCook::~BackgroundCook()
+{
+	cancel();
+}
+
+
+void BackgroundCook::start(const GU_Detail &source, const GA_PrimitiveGroup *source_group, const CookKey &key)
+{
+	cancel();
+	detail.clearAndDestroy();
+	detail.duplicate(source);
+	// Indices survive the copy, offsets need not
+	GA_PrimitiveGroup *group = nullptr;
+	if (source_group != nullptr) {
+		group = detail.newPrimitiveGroup(SOURCE_GROUP);
+		for (GA_Iterator it(source.getPrimitiveRange(source_group)); !it.atEnd(); ++it)
+			group->addOffset(detail.primitiveOffset(source.primitiveIndex(*it)));
+	}
+	job_key = key;
+	started = true;
+	done = false;
+	generator.reset(new Generator(false));
+	worker = std::thread([this, group]() {
+		job_result = generator->generate(&detail, group, job_key.parms);
+		if (group != nullptr)
+			detail.destroyPrimitiveGroup(group);
+		done = true;
+	});
+}
+
+
+void BackgroundCook::cancel()
+{
+	if (worker.joinable()) {
+		generator->cancel();
+		worker.join();
+	}
+	started = false;
+	done = false;
+}
+
+
+bool BackgroundCook::busy(const CookKey &key) const
+{
+	return started && !done && job_key == key;
+}
+
+
+bool BackgroundCook::fetch(const CookKey &key, GU_Detail *gdp, GeneratorResult &result, UT_String &error, UT_String &warning) const
+{
+	if (!started || !done || !(job_key == key))
+		return false;
+	gdp->duplicate(detail);
+	result = job_result;
+	error.harden(generator->error());
+	warning.harden(generator->warning());
+	return true;
+}
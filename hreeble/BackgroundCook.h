@@ -0,0 +1,46 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <UT/UT_String.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include "Generator.h"
+
+// What a background result was generated from. The input is identified by its
+// content hash, an upstream recook giving the same geometry keeps the job.
+struct CookKey
+{
+	GeneratorParms parms;
+	std::string source_groups;
+	uint64 input_hash;
+
+	bool operator==(const CookKey &other) const
+	{
+		return input_hash == other.input_hash && source_groups == other.source_groups && parms == other.parms;
+	}
+};
+
+// Runs one generation on a private copy of the input on a worker thread.
+// Starting another one cancels it, the last finished result stays available.
+class BackgroundCook
+{
+public:
+	BackgroundCook();
+	~BackgroundCook();
+	void start(const GU_Detail &source, const GA_PrimitiveGroup *source_group, const CookKey &key);
+	void cancel();
+	// Started for key and not finished yet
+	bool busy(const CookKey &key) const;
+	// Copies the finished result for key into gdp, false while there is none
+	bool fetch(const CookKey &key, GU_Detail *gdp, GeneratorResult &result, UT_String &error, UT_String &warning) const;
+
+private:
+	std::thread worker;
+	std::unique_ptr<Generator> generator;
+	GU_Detail detail;
+	CookKey job_key;
+	bool started;
+	std::atomic<bool> done;
+	GeneratorResult job_result;
+};
@@ -0,0 +1,85 @@
+#include "Bevel.h"
+#include <SYS/SYS_Math.h>
+
+// Sharp corners would shoot the rings far past the outline
+static const fpreal64 MITER_LIMIT = 2.0;
+
+BevelProfile::BevelProfile()
+{
+	set(BevelShapes::CHAMFER, 0);
+}
+
+
+void BevelProfile::set(const BevelShapes &shape, const int &segments)
+{
+	insets.clear();
+	drops.clear();
+	arcs.clear();
+	if (segments <= 0) {
+		insets.append(0.0f);
+		drops.append(0.0f);
+		arcs.append(0.0f);
+		return;
+	}
+	fpreal64 step = shape == BevelShapes::ROUND ? 2.0 * SYSsin(M_PI / (4.0 * segments)) : SYSsqrt(2.0) / segments;
+	for (int k = 0; k <= segments; k++) {
+		fpreal64 t = fpreal64(k) / segments;
+		if (shape == BevelShapes::ROUND) {
+			insets.append(1.0 - SYScos(t * M_PI * 0.5));
+			drops.append(1.0 - SYSsin(t * M_PI * 0.5));
+		}
+		else {
+			insets.append(t);
+			drops.append(1.0 - t);
+		}
+		arcs.append((segments - k) * step);
+	}
+}
+
+
+void hreeble::outline_miters(const fpreal32 *xs, const fpreal32 *ys, const exint &num, const fpreal &su, const fpreal &sv,
+							 const bool hole, fpreal32 *miter_xs, fpreal32 *miter_ys)
+{
+	fpreal64 area = 0.0;
+	for (exint i = 0; i < num; i++) {
+		exint j = (i + 1) % num;
+		area += (fpreal64(xs[i]) * ys[j] - fpreal64(xs[j]) * ys[i]) * su * sv;
+	}
+	// Left of a counter-clockwise edge is inside
+	fpreal64 side = (area > 0.0) != hole ? 1.0 : -1.0;
+	auto edge_normal = [&](const exint &a, const exint &b, fpreal64 &nx, fpreal64 &ny) {
+		fpreal64 dx = (fpreal64(xs[b]) - xs[a]) * su;
+		fpreal64 dy = (fpreal64(ys[b]) - ys[a]) * sv;
+		fpreal64 len = SYSsqrt(dx * dx + dy * dy);
+		if (len <= 0.0)
+			return false;
+		nx = -dy * side / len;
+		ny = dx * side / len;
+		return true;
+	};
+	for (exint i = 0; i < num; i++) {
+		fpreal64 n0x = 0.0, n0y = 0.0, n1x = 0.0, n1y = 0.0;
+		bool has0 = edge_normal((i + num - 1) % num, i, n0x, n0y);
+		bool has1 = edge_normal(i, (i + 1) % num, n1x, n1y);
+		if (!has0) { n0x = n1x; n0y = n1y; }
+		if (!has1) { n1x = n0x; n1y = n0y; }
+		fpreal64 mx = n0x + n1x, my = n0y + n1y;
+		fpreal64 denom = 1.0 + n0x * n1x + n0y * n1y;
+		if (denom > 1e-6) {
+			mx /= denom;
+			my /= denom;
+		}
+		else {
+			// Folded back spike, just push along one side
+			mx = n1x;
+			my = n1y;
+		}
+		fpreal64 len = SYSsqrt(mx * mx + my * my);
+		if (len > MITER_LIMIT) {
+			mx *= MITER_LIMIT / len;
+			my *= MITER_LIMIT / len;
+		}
+		miter_xs[i] = fpreal32(mx / su);
+		miter_ys[i] = fpreal32(my / sv);
+	}
+}
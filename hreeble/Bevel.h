@@ -0,0 +1,37 @@
+#pragma once
+#include <UT/UT_SmallArray.h>
+#include <SYS/SYS_Types.h>
+
+enum class BevelShapes {
+	CHAMFER = 0,
+	ROUND = 1,
+};
+
+// Cross section of a bevelled top edge, shared by every element and panel of a
+// cook. Row k describes one ring between the wall top (first row) and the cap
+// (last row) in units of the bevel size: how far it is inset from the wall,
+// how far it sits below the top and the profile length left up to the cap.
+class BevelProfile
+{
+public:
+	BevelProfile();
+	void set(const BevelShapes &shape, const int &segments);
+	exint num_rows() const { return insets.entries(); }
+	bool is_flat() const { return insets.entries() == 1; }
+	fpreal32 inset(const exint &row) const { return insets(row); }
+	fpreal32 drop(const exint &row) const { return drops(row); }
+	fpreal32 arc(const exint &row) const { return arcs(row); }
+
+private:
+	UT_SmallArray<fpreal32, 8 * sizeof(fpreal32)> insets;
+	UT_SmallArray<fpreal32, 8 * sizeof(fpreal32)> drops;
+	UT_SmallArray<fpreal32, 8 * sizeof(fpreal32)> arcs;
+};
+
+namespace hreeble {
+	// Per vertex offset of a closed outline moving its edges one unit into the
+	// solid (out of it for holes). Coordinates are scaled by su/sv into world
+	// units first, the miters are written back in outline units.
+	void outline_miters(const fpreal32 *xs, const fpreal32 *ys, const exint &num, const fpreal &su, const fpreal &sv,
+						const bool hole, fpreal32 *miter_xs, fpreal32 *miter_ys);
+}
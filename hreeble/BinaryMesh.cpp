@@ -0,0 +1,413 @@
+#include "BinaryMesh.h"
+#include <GU/GU_PrimPoly.h>
+#include <GEO/GEO_PolyCounts.h>
+#include <GA/GA_Handle.h>
+#include <GA/GA_AIFTuple.h>
+#include <GA/GA_GBMacros.h>
+#include <UT/UT_Array.h>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char HMESH_MAGIC[8] = { 'H', 'R', 'H', 'M', 'E', 'S', 'H', '\0' };
+static const uint32 HMESH_VERSION = 1;
+static const uint64 HMESH_ALIGN = 16;
+
+namespace {
+	uint64 aligned(const uint64 &size)
+	{
+		return (size + HMESH_ALIGN - 1) & ~(HMESH_ALIGN - 1);
+	}
+
+	// Read only view of a whole file
+	class MappedFile
+	{
+	public:
+		MappedFile() :data(nullptr), size(0)
+		{
+#ifdef _WIN32
+			file = INVALID_HANDLE_VALUE;
+			mapping = nullptr;
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (data)
+				UnmapViewOfFile(data);
+			if (mapping)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+#else
+			if (data)
+				munmap(const_cast<char*>(data), size);
+#endif
+		}
+
+		bool open(const char *path)
+		{
+#ifdef _WIN32
+			file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			LARGE_INTEGER file_size;
+			if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+				return false;
+			size = uint64(file_size.QuadPart);
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping)
+				return false;
+			data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+			int fd = ::open(path, O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0) {
+				close(fd);
+				return false;
+			}
+			size = uint64(st.st_size);
+			void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (mapped == MAP_FAILED)
+				return false;
+			madvise(mapped, size, MADV_SEQUENTIAL);
+			data = static_cast<const char*>(mapped);
+#endif
+			return data != nullptr;
+		}
+
+		const char *data;
+		uint64 size;
+
+	private:
+#ifdef _WIN32
+		HANDLE file;
+		HANDLE mapping;
+#endif
+	};
+}
+
+
+bool hreeble::is_hmesh_path(const char *path)
+{
+	size_t len = strlen(path);
+	return len > 6 && !strcmp(path + len - 6, ".hmesh");
+}
+
+
+bool hreeble::hmesh_lossless(const GU_Detail *gdp)
+{
+	// Everything save_hmesh drops or load_hmesh adds back differently
+	for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+		const GA_Primitive *prim = gdp->getPrimitive(*it);
+		if (prim->getTypeId() != GA_PRIMPOLY || !static_cast<const GEO_PrimPoly*>(prim)->isClosed())
+			return false;
+	}
+	for (GA_AttributeDict::iterator it = gdp->pointAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+		if (it.attrib() != gdp->getP())
+			return false;
+	}
+	const GA_Attribute *uvattr = gdp->findTextureAttribute(GA_ATTRIB_VERTEX);
+	for (GA_AttributeDict::iterator it = gdp->vertexAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+		const GA_Attribute *attr = it.attrib();
+		if (attr != uvattr || strcmp(attr->getName(), "uv") || attr->getTupleSize() != 3
+			|| !attr->getAIFTuple() || attr->getAIFTuple()->getStorage(attr) != GA_STORE_REAL32)
+			return false;
+	}
+	for (GA_AttributeDict::iterator it = gdp->primitiveAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+		const GA_Attribute *attr = it.attrib();
+		const char *name = attr->getName();
+		GA_Storage storage = attr->getAIFTuple() ? attr->getAIFTuple()->getStorage(attr) : GA_STORE_INVALID;
+		if ((storage != GA_STORE_REAL32 && storage != GA_STORE_INT32) || strlen(name) >= sizeof(HMeshAttrib::name))
+			return false;
+	}
+	if (!gdp->attribs().begin(GA_SCOPE_PUBLIC).atEnd())
+		return false;
+	const GA_PrimitiveGroup *prim_group;
+	GA_FOR_ALL_PRIMGROUPS(gdp, prim_group) {
+		if (!prim_group->isInternal())
+			return false;
+	}
+	const GA_PointGroup *point_group;
+	GA_FOR_ALL_POINTGROUPS(gdp, point_group) {
+		if (!point_group->isInternal())
+			return false;
+	}
+	return gdp->vertexGroups().entries() == 0 && gdp->edgeGroups().entries() == 0;
+}
+
+
+bool hreeble::load_hmesh(const char *path, GU_Detail *gdp, UT_String &error)
+{
+	MappedFile file;
+	if (!file.open(path)) {
+		error.sprintf("Could not map %s", path);
+		return false;
+	}
+	// Meshes stored back to back load one after the other, each indexes its own points
+	uint64 pos = 0;
+	while (pos < file.size) {
+		const HMeshHeader *header = reinterpret_cast<const HMeshHeader*>(file.data + pos);
+		if (file.size - pos < sizeof(HMeshHeader) || memcmp(header->magic, HMESH_MAGIC, sizeof(HMESH_MAGIC))) {
+			error.sprintf("%s is not a hmesh file", path);
+			return false;
+		}
+		if (header->version != HMESH_VERSION) {
+			error.sprintf("%s has hmesh version %u, expected %u", path, header->version, HMESH_VERSION);
+			return false;
+		}
+
+		// Locate and check every block before touching the detail, a truncated
+		// or corrupt file fails cleanly instead of reading past the mapping
+		uint64 table_bytes = file.size - pos - sizeof(HMeshHeader);
+		if (header->num_prim_attribs > table_bytes / sizeof(HMeshAttrib)) {
+			error.sprintf("%s is truncated", path);
+			return false;
+		}
+		const HMeshAttrib *attribs = reinterpret_cast<const HMeshAttrib*>(file.data + pos + sizeof(HMeshHeader));
+		for (uint32 a = 0; a < header->num_prim_attribs; a++) {
+			if (!memchr(attribs[a].name, '\0', sizeof(attribs[a].name)) || attribs[a].name[0] == '\0'
+				|| attribs[a].tuple_size == 0 || (attribs[a].storage != HMESH_FLOAT32 && attribs[a].storage != HMESH_INT32)) {
+				error.sprintf("%s has a corrupt attribute table", path);
+				return false;
+			}
+		}
+		pos = aligned(pos + sizeof(HMeshHeader) + header->num_prim_attribs * sizeof(HMeshAttrib));
+		bool fits = true;
+		auto block = [&](const uint64 &count, const uint64 &item_bytes) {
+			uint64 start = pos;
+			if (!fits || start > file.size || count > (file.size - start) / item_bytes) {
+				fits = false;
+				return uint64(0);
+			}
+			pos = aligned(start + count * item_bytes);
+			return start;
+		};
+		uint64 positions = block(header->num_points, 3 * sizeof(fpreal32));
+		uint64 counts = block(header->num_faces, sizeof(uint32));
+		uint64 indices = block(header->num_indices, sizeof(uint32));
+		bool has_uvs = (header->flags & HMESH_HAS_UVS) != 0;
+		uint64 uvs = has_uvs ? block(header->num_indices, 3 * sizeof(fpreal32)) : 0;
+		UT_Array<uint64> attrib_blocks;
+		for (uint32 a = 0; a < header->num_prim_attribs; a++)
+			attrib_blocks.append(block(header->num_faces, uint64(attribs[a].tuple_size) * 4));
+		if (!fits) {
+			error.sprintf("%s is truncated", path);
+			return false;
+		}
+		const uint32 *face_counts = reinterpret_cast<const uint32*>(file.data + counts);
+		const uint32 *face_indices = reinterpret_cast<const uint32*>(file.data + indices);
+		uint64 num_vertices = 0;
+		for (uint64 f = 0; f < header->num_faces; f++)
+			num_vertices += face_counts[f];
+		bool valid = num_vertices == header->num_indices && header->num_points <= uint64(SYS_INT32_MAX);
+		for (uint64 i = 0; i < header->num_indices && valid; i++)
+			valid = face_indices[i] < header->num_points;
+		if (!valid) {
+			error.sprintf("%s has corrupt faces", path);
+			return false;
+		}
+
+		GA_Offset start_pt = gdp->appendPointBlock(GA_Size(header->num_points));
+		GA_RWHandleV3 phandle(gdp->getP());
+		phandle.setBlock(start_pt, GA_Size(header->num_points), reinterpret_cast<const UT_Vector3F*>(file.data + positions));
+
+		GEO_PolyCounts poly_counts;
+		for (uint64 f = 0; f < header->num_faces; f++)
+			poly_counts.append(GA_Size(face_counts[f]));
+		GA_Offset start_prim = GU_PrimPoly::buildBlock(gdp, start_pt, GA_Size(header->num_points), poly_counts,
+													   reinterpret_cast<const int*>(face_indices));
+
+		if (has_uvs) {
+			GA_RWHandleV3 uvhandle(gdp->addTextureAttribute(GA_ATTRIB_VERTEX));
+			const UT_Vector3F *uv_data = reinterpret_cast<const UT_Vector3F*>(file.data + uvs);
+			exint index = 0;
+			for (uint64 f = 0; f < header->num_faces; f++) {
+				const GA_Primitive *prim = gdp->getPrimitive(start_prim + GA_Offset(f));
+				for (GA_Size v = 0; v < prim->getVertexCount(); v++)
+					uvhandle.set(prim->getVertexOffset(v), uv_data[index++]);
+			}
+		}
+		for (uint32 a = 0; a < header->num_prim_attribs; a++) {
+			UT_String name(attribs[a].name);
+			int tuple_size = int(attribs[a].tuple_size);
+			const char *values = file.data + attrib_blocks(a);
+			if (attribs[a].storage == HMESH_INT32) {
+				GA_RWHandleI handle(gdp->addIntTuple(GA_ATTRIB_PRIMITIVE, name, tuple_size));
+				const int32 *ints = reinterpret_cast<const int32*>(values);
+				if (tuple_size == 1) {
+					handle.setBlock(start_prim, GA_Size(header->num_faces), ints);
+					continue;
+				}
+				for (uint64 f = 0; f < header->num_faces; f++) {
+					for (int c = 0; c < tuple_size; c++)
+						handle.set(start_prim + GA_Offset(f), c, ints[f * tuple_size + c]);
+				}
+			}
+			else {
+				GA_RWHandleF handle(gdp->addFloatTuple(GA_ATTRIB_PRIMITIVE, name, tuple_size));
+				const fpreal32 *floats = reinterpret_cast<const fpreal32*>(values);
+				if (tuple_size == 1) {
+					handle.setBlock(start_prim, GA_Size(header->num_faces), floats);
+					continue;
+				}
+				for (uint64 f = 0; f < header->num_faces; f++) {
+					for (int c = 0; c < tuple_size; c++)
+						handle.set(start_prim + GA_Offset(f), c, floats[f * tuple_size + c]);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+
+bool hreeble::save_hmesh(const GU_Detail *gdp, const char *path, UT_String &error, const GA_OffsetList *faces)
+{
+	// Only the points the written faces use, numbered in detail order
+	UT_Array<exint> point_numbers;
+	UT_Array<fpreal32> positions;
+	if (faces) {
+		point_numbers.setSize(gdp->getNumPointOffsets());
+		point_numbers.constant(-1);
+		for (exint f = 0; f < faces->entries(); f++) {
+			const GA_Primitive *prim = gdp->getPrimitive((*faces)(f));
+			for (GA_Size v = 0; v < prim->getVertexCount(); v++)
+				point_numbers(prim->getPointOffset(v)) = 0;
+		}
+	}
+	exint num_points = 0;
+	for (GA_Iterator it(gdp->getPointRange()); !it.atEnd(); ++it) {
+		if (faces) {
+			if (point_numbers(*it) < 0)
+				continue;
+			point_numbers(*it) = num_points;
+		}
+		num_points++;
+		UT_Vector3 P = gdp->getPos3(*it);
+		positions.append(P.x());
+		positions.append(P.y());
+		positions.append(P.z());
+	}
+	auto point_number = [&](const GA_Offset &ptof) {
+		return uint32(faces ? point_numbers(ptof) : exint(gdp->pointIndex(ptof)));
+	};
+
+	// Float and 32 bit int primitive attributes travel with the faces
+	GA_ROHandleV3 uvhandle(gdp->findTextureAttribute(GA_ATTRIB_VERTEX));
+	UT_Array<const GA_Attribute*> prim_attribs;
+	for (GA_AttributeDict::iterator it = gdp->primitiveAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+		const GA_Attribute *attr = it.attrib();
+		const char *name = attr->getName();
+		GA_Storage storage = attr->getAIFTuple() ? attr->getAIFTuple()->getStorage(attr) : GA_STORE_INVALID;
+		if ((storage == GA_STORE_REAL32 || storage == GA_STORE_INT32) && strlen(name) < sizeof(HMeshAttrib::name))
+			prim_attribs.append(attr);
+	}
+	UT_Array<uint32> face_counts, indices;
+	UT_Array<fpreal32> uvs;
+	UT_Array<UT_Array<int32>> attrib_values;
+	attrib_values.setSize(prim_attribs.entries());
+	auto add_face = [&](const GA_Offset &primoff) {
+		const GA_Primitive *prim = gdp->getPrimitive(primoff);
+		if (prim->getTypeId() != GA_PRIMPOLY)
+			return;
+		GA_Size num_vtx = prim->getVertexCount();
+		face_counts.append(uint32(num_vtx));
+		for (GA_Size v = 0; v < num_vtx; v++) {
+			indices.append(point_number(prim->getPointOffset(v)));
+			if (uvhandle.isValid()) {
+				UT_Vector3 uv = uvhandle.get(prim->getVertexOffset(v));
+				uvs.append(uv.x());
+				uvs.append(uv.y());
+				uvs.append(uv.z());
+			}
+		}
+		// Values keep their bits, ints and floats share one 4 byte array
+		for (exint a = 0; a < prim_attribs.entries(); a++) {
+			const GA_Attribute *attr = prim_attribs(a);
+			for (int c = 0; c < attr->getTupleSize(); c++) {
+				if (attr->getAIFTuple()->getStorage(attr) == GA_STORE_INT32) {
+					int32 value;
+					attr->getAIFTuple()->get(attr, primoff, value, c);
+					attrib_values(a).append(value);
+				}
+				else {
+					fpreal32 value;
+					attr->getAIFTuple()->get(attr, primoff, value, c);
+					int32 bits;
+					memcpy(&bits, &value, sizeof(bits));
+					attrib_values(a).append(bits);
+				}
+			}
+		}
+	};
+	if (faces) {
+		for (exint f = 0; f < faces->entries(); f++)
+			add_face((*faces)(f));
+	}
+	else {
+		for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it)
+			add_face(*it);
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		error.sprintf("Could not open %s", path);
+		return false;
+	}
+	HMeshHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HMESH_MAGIC, sizeof(HMESH_MAGIC));
+	header.version = HMESH_VERSION;
+	header.flags = uvhandle.isValid() ? HMESH_HAS_UVS : 0;
+	header.num_points = num_points;
+	header.num_faces = face_counts.entries();
+	header.num_indices = indices.entries();
+	header.num_prim_attribs = uint32(prim_attribs.entries());
+	uint64 written = 0;
+	const char zeros[HMESH_ALIGN] = { 0 };
+	auto write_block = [&](const void *data, const uint64 &bytes) {
+		if (bytes != 0 && fwrite(data, 1, bytes, file) != bytes)
+			return false;
+		written += bytes;
+		uint64 pad = aligned(written) - written;
+		if (pad != 0 && fwrite(zeros, 1, pad, file) != pad)
+			return false;
+		written += pad;
+		return true;
+	};
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	written = sizeof(header);
+	for (exint a = 0; a < prim_attribs.entries() && ok; a++) {
+		HMeshAttrib attrib;
+		memset(&attrib, 0, sizeof(attrib));
+		const char *name = prim_attribs(a)->getName();
+		strcpy(attrib.name, name);
+		attrib.tuple_size = uint32(prim_attribs(a)->getTupleSize());
+		attrib.storage = prim_attribs(a)->getAIFTuple()->getStorage(prim_attribs(a)) == GA_STORE_INT32 ? HMESH_INT32 : HMESH_FLOAT32;
+		ok = fwrite(&attrib, sizeof(attrib), 1, file) == 1;
+		written += sizeof(attrib);
+	}
+	ok = ok && write_block(nullptr, 0)
+		&& write_block(positions.data(), positions.entries() * sizeof(fpreal32))
+		&& write_block(face_counts.data(), face_counts.entries() * sizeof(uint32))
+		&& write_block(indices.data(), indices.entries() * sizeof(uint32))
+		&& write_block(uvs.data(), uvs.entries() * sizeof(fpreal32));
+	for (exint a = 0; a < attrib_values.entries() && ok; a++)
+		ok = write_block(attrib_values(a).data(), attrib_values(a).entries() * sizeof(int32));
+	fclose(file);
+	if (!ok) {
+		remove(path);
+		error.sprintf("Could not write %s", path);
+	}
+	return ok;
+}
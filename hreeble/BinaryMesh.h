@@ -0,0 +1,49 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <UT/UT_String.h>
+#include <SYS/SYS_Types.h>
+
+// Native polygon mesh format of the standalone pipeline (.hmesh). Every block
+// is a flat array starting on a 16 byte boundary, in this order:
+//   positions     3 x fpreal32 per point
+//   face counts   uint32 per face
+//   indices       uint32 point number per face vertex
+//   uvs           3 x fpreal32 per face vertex, when HMESH_HAS_UVS is set
+//   prim attribs  tuple_size x fpreal32 or int32 per face, one block per attribute
+// The attribute table (HMeshAttrib records) follows the header. Files are
+// read through a memory map, point and index blocks go straight into the
+// detail without an intermediate copy. Indices are local to their mesh, so
+// several meshes written back to back are one valid file and load as one
+// detail: merging partitions is plain concatenation.
+struct HMeshHeader
+{
+	char magic[8];
+	uint32 version;
+	uint32 flags;
+	uint64 num_points;
+	uint64 num_faces;
+	uint64 num_indices;
+	uint32 num_prim_attribs;
+	uint32 reserved;
+};
+
+struct HMeshAttrib
+{
+	char name[56];
+	uint32 tuple_size;
+	uint32 storage;
+};
+
+const uint32 HMESH_HAS_UVS = 0x1;
+const uint32 HMESH_FLOAT32 = 0;
+const uint32 HMESH_INT32 = 1;
+
+namespace hreeble {
+	bool is_hmesh_path(const char *path);
+	// True when a save and load round trip gives back the same detail
+	bool hmesh_lossless(const GU_Detail *gdp);
+	bool load_hmesh(const char *path, GU_Detail *gdp, UT_String &error);
+	// Polygons only, float and int primitive attributes are kept. With faces
+	// set only those are written, together with the points they use.
+	bool save_hmesh(const GU_Detail *gdp, const char *path, UT_String &error, const GA_OffsetList *faces = nullptr);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <GA/GA_AttributeRefMap.h>
+#include <GA/GA_Handle.h>
+#include <memory>
+#include <vector>
+#include "Element.h"
+
+// Private detail that elements are built into while the target is only read.
+// It mirrors the attributes and groups elements write, so a whole batch of
+// buffers can be spliced into the target at once instead of growing it element
+// by element from one thread.
+class ElementBuffer
+{
+public:
+	ElementBuffer(const GU_Detail &target, const GA_Attribute *uvattr, const GA_Attribute *normal_attr, const GA_Attribute *tangent_attr,
+				  const GA_PrimitiveGroup *elem_grp, const GA_PrimitiveGroup *elem_front_grp, const bool inherit_attribs);
+	GU_Detail *detail() { return &buffer; }
+	// Points an element's output at this buffer, hosts stay in the target
+	void bind(Element &element);
+	// Appends the buffers to target in order, one block of points and prims for all of them
+	static void splice(GU_Detail *target, const std::vector<std::unique_ptr<ElementBuffer>> &buffers);
+
+private:
+	GU_Detail buffer;
+	GA_AttributeRefMap prim_refmap;
+	GA_Attribute *uvattr;
+	GA_RWHandleV3 normal_handle;
+	GA_RWHandleV3 tangent_handle;
+	GA_PrimitiveGroup *elem_group;
+	GA_PrimitiveGroup *elem_front_group;
+};
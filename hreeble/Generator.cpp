@@ -0,0 +1,1103 @@
+#include "Generator.h"
+#include <UT/UT_Vector2.h>
+#include <UT/UT_Vector3Array.h>
+#include <UT/UT_Interrupt.h>
+#include <UT/UT_Quaternion.h>
+#include <UT/UT_ParallelUtil.h>
+#include <UT/UT_Thread.h>
+#include <SYS/SYS_Math.h>
+#include <GU/GU_PrimPoly.h>
+#include <GU/GU_PackedGeometry.h>
+#include <GU/GU_PrimPacked.h>
+#include <GA/GA_ElementWrangler.h>
+#include <GA/GA_PageHandle.h>
+#include <cstring>
+#include "misc.h"
+#include "UVFrame.h"
+#include "Triangulate.h"
+#include "MeshFile.h"
+#include "GeoHash.h"
+#include "Layout.h"
+
+// Gap between packed element charts, in uv units
+static const fpreal ATLAS_PADDING = 0.002;
+// Stitched elements keep at least this much host parameter space between each other
+static const fpreal STITCH_MARGIN = 0.005;
+// Rough footprint of generated geometry, used to turn the memory budget into a chunk size
+static const exint PANEL_BYTES = 1024;
+static const exint ELEMENT_BYTES = 1536;
+// Interrupt checks are amortized over this many generated elements
+static const exint INTERRUPT_BATCH = 256;
+// Source faces planned together, bounds the elements held before they are built
+static const exint PLAN_BATCH = 4096;
+static const exint TASKS_PER_THREAD = 8;
+// Per source face controls, read whether attributes are inherited or not
+static const char *const FACE_CONTROL_ATTRIBS[] = { FACE_ID_ATTRIB, "hreeble_density", "hreeble_scale", "hreeble_height", "hreeble_mask" };
+
+GeneratorParms::GeneratorParms()
+	:seed(12345), generate_panels(1), panel_inset(0.01), elem_density(1), shapes(4), convex(1), create_groups(0), unwrap_uvs(0),
+	inherit_attribs(1), output_mode(OutputModes::POLYGONS), chunked_cook(0), chunk_size(10000), memory_budget(0.0),
+	lod_mode(LODModes::OFF), lod_camera(0.0, 0.0, 0.0), lod_cap_size(0.01), lod_cull_size(0.002), library_shapes("*"),
+	cap_triangles(0), elem_bevel(0.0), panel_bevel(0.0), bevel_shape(BevelShapes::CHAMFER), bevel_segments(1), elem_tiers(1),
+	tier_falloff(0.5), pack_uvs(0), uv_tile(1), output_normals(0), watertight(WatertightModes::OFF)
+{
+	panel_height[0] = 0.001;
+	panel_height[1] = 0.1;
+	elem_scale[0] = 0.5;
+	elem_scale[1] = 1.0;
+	elem_height[0] = 0.02;
+	elem_height[1] = 0.1;
+}
+
+bool GeneratorParms::operator==(const GeneratorParms &other) const
+{
+	return seed == other.seed && generate_panels == other.generate_panels && panel_inset == other.panel_inset
+		&& panel_height[0] == other.panel_height[0] && panel_height[1] == other.panel_height[1] && elem_density == other.elem_density
+		&& elem_scale[0] == other.elem_scale[0] && elem_scale[1] == other.elem_scale[1]
+		&& elem_height[0] == other.elem_height[0] && elem_height[1] == other.elem_height[1] && shapes == other.shapes
+		&& convex == other.convex && create_groups == other.create_groups && unwrap_uvs == other.unwrap_uvs
+		&& inherit_attribs == other.inherit_attribs && output_mode == other.output_mode && chunked_cook == other.chunked_cook
+		&& chunk_size == other.chunk_size && memory_budget == other.memory_budget && lod_mode == other.lod_mode
+		&& lod_camera == other.lod_camera && lod_cap_size == other.lod_cap_size && lod_cull_size == other.lod_cull_size
+		&& shape_library == other.shape_library && library_shapes == other.library_shapes && cap_triangles == other.cap_triangles
+		&& elem_bevel == other.elem_bevel && panel_bevel == other.panel_bevel && bevel_shape == other.bevel_shape
+		&& bevel_segments == other.bevel_segments && elem_tiers == other.elem_tiers && tier_falloff == other.tier_falloff
+		&& pack_uvs == other.pack_uvs && uv_tile == other.uv_tile && output_normals == other.output_normals
+		&& watertight == other.watertight && mesh_file == other.mesh_file;
+}
+
+uint64 GeneratorParms::hash() const
+{
+	hreeble::Hasher h;
+	h.add_uint(seed);
+	h.add_uint(generate_panels);
+	h.add_float(panel_inset);
+	h.add_float(panel_height[0]);
+	h.add_float(panel_height[1]);
+	h.add_uint(elem_density);
+	h.add_float(elem_scale[0]);
+	h.add_float(elem_scale[1]);
+	h.add_float(elem_height[0]);
+	h.add_float(elem_height[1]);
+	h.add_uint(shapes);
+	h.add_uint(convex);
+	h.add_uint(create_groups);
+	h.add_uint(unwrap_uvs);
+	h.add_uint(inherit_attribs);
+	h.add_uint(uint64(output_mode));
+	h.add_uint(chunked_cook);
+	h.add_uint(uint64(chunk_size));
+	h.add_float(memory_budget);
+	h.add_uint(uint64(lod_mode));
+	for (int i = 0; i < 3; i++)
+		h.add_float(lod_camera(i));
+	h.add_float(lod_cap_size);
+	h.add_float(lod_cull_size);
+	h.add_string(shape_library.c_str());
+	h.add_string(library_shapes.c_str());
+	h.add_uint(cap_triangles);
+	h.add_float(elem_bevel);
+	h.add_float(panel_bevel);
+	h.add_uint(uint64(bevel_shape));
+	h.add_uint(uint64(bevel_segments));
+	h.add_uint(elem_tiers);
+	h.add_float(tier_falloff);
+	h.add_uint(pack_uvs);
+	h.add_uint(uint64(uv_tile));
+	h.add_uint(output_normals);
+	h.add_uint(uint64(watertight));
+	h.add_string(mesh_file.c_str());
+	return h.value();
+}
+
+Generator::Generator(const bool interruptible):
+	gdp(nullptr), parms(nullptr), uvattr(nullptr), elements_group(nullptr), elements_front_group(nullptr), my_seed(0),
+	output_mode(OutputModes::POLYGONS), lod_mode(LODModes::OFF), pack_uvs(false), watertight(WatertightModes::OFF),
+	interruptible(interruptible), cancelled(false)
+{
+}
+
+void Generator::face_attribs(const GU_Detail *detail, const GeneratorParms &parms, UT_Array<const GA_Attribute*> &attribs)
+{
+	// Matches what prim_refmap binds in generate()
+	attribs.clear();
+	for (GA_AttributeDict::iterator it = detail->primitiveAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+		bool control = false;
+		for (const auto name : FACE_CONTROL_ATTRIBS)
+			control |= !strcmp(it.attrib()->getName(), name);
+		if (control || parms.inherit_attribs != 0)
+			attribs.append(it.attrib());
+	}
+}
+
+bool Generator::was_interrupted(UT_AutoInterrupt *boss, const int &percent)
+{
+	return cancelled || (boss != nullptr && boss->wasInterrupted(percent));
+}
+
+void Generator::split_primitive(GEO_Primitive * source_prim, UT_ValArray<GEO_Primitive*>& result, const unsigned short dir)
+{
+	GA_OffsetArray prim_ptoffs;
+	GA_OffsetArray prim_vtoffs;
+	UT_Vector3Array corners;
+	for (GA_Iterator it(source_prim->getVertexRange()); !it.atEnd(); ++it){
+		prim_vtoffs.append(*it);
+		prim_ptoffs.append(gdp->vertexPoint(*it));
+		corners.append(phandle.get(prim_ptoffs.last()));
+	}
+	// Halves quads only, anything else stays whole
+	UT_Vector3 mid0, mid1;
+	if (!hreeble::quad_split_points(reinterpret_cast<const fpreal32*>(corners.data()), corners.entries(), dir, mid0.data(), mid1.data())) {
+		result.append(source_prim);
+		return;
+	}
+
+	GA_Offset new_ptof = gdp->appendPointBlock(2);
+	GA_VertexWrangler twrangler(*gdp);
+	//auto VtxToPt = [this](const GEO_PrimPoly *prim, const GA_Size &index) {return gdp->vertexPoint(prim->getVertexOffset(index)); };
+	GEO_PrimPoly *prim1 = GEO_PrimPoly::build(gdp, 4, false, false);
+	GEO_PrimPoly *prim2 = GEO_PrimPoly::build(gdp, 4, false, false);
+	phandle.set(new_ptof, mid0); // top middle for dir 0, left middle for dir 1
+	phandle.set(new_ptof + 1, mid1); // bottom middle, right middle
+	if (dir == 0) {
+		prim1->setVertexPoint(0, prim_ptoffs(0));
+		twrangler.copyAttributeValues(prim1->getVertexOffset(0), prim_vtoffs(0));
+		prim1->setVertexPoint(1, prim_ptoffs(1));
+		twrangler.copyAttributeValues(prim1->getVertexOffset(1), prim_vtoffs(1));
+		prim1->setVertexPoint(2, new_ptof);
+		twrangler.lerpAttributeValues(prim1->getVertexOffset(2), prim_vtoffs(1), prim_vtoffs(2), 0.5);
+		prim1->setVertexPoint(3, new_ptof + 1);
+		twrangler.lerpAttributeValues(prim1->getVertexOffset(3), prim_vtoffs(0), prim_vtoffs(3), 0.5);
+		
+		prim2->setVertexPoint(0, new_ptof+1);
+		twrangler.lerpAttributeValues(prim2->getVertexOffset(0), prim_vtoffs(0), prim_vtoffs(3), 0.5);
+		prim2->setVertexPoint(1, new_ptof);
+		twrangler.lerpAttributeValues(prim2->getVertexOffset(1), prim_vtoffs(1), prim_vtoffs(2), 0.5);
+		prim2->setVertexPoint(2, prim_ptoffs(2));
+		twrangler.copyAttributeValues(prim2->getVertexOffset(2), prim_vtoffs(2));
+		prim2->setVertexPoint(3, prim_ptoffs(3));
+		twrangler.copyAttributeValues(prim2->getVertexOffset(3), prim_vtoffs(3));
+	}
+	else {
+		prim1->setVertexPoint(0, prim_ptoffs(0));
+		twrangler.copyAttributeValues(prim1->getVertexOffset(0), prim_vtoffs(0));
+		prim1->setVertexPoint(1, new_ptof);
+		twrangler.lerpAttributeValues(prim1->getVertexOffset(1), prim_vtoffs(0), prim_vtoffs(1), 0.5);
+		prim1->setVertexPoint(2, new_ptof + 1);
+		twrangler.lerpAttributeValues(prim1->getVertexOffset(2), prim_vtoffs(2), prim_vtoffs(3), 0.5);
+		prim1->setVertexPoint(3, prim_ptoffs(3));
+		twrangler.copyAttributeValues(prim1->getVertexOffset(3), prim_vtoffs(3));
+		
+		prim2->setVertexPoint(0, new_ptof);
+		twrangler.lerpAttributeValues(prim2->getVertexOffset(0), prim_vtoffs(0), prim_vtoffs(1), 0.5);
+		prim2->setVertexPoint(1, prim_ptoffs(1));
+		twrangler.copyAttributeValues(prim2->getVertexOffset(1), prim_vtoffs(1));
+		prim2->setVertexPoint(2, prim_ptoffs(2));
+		twrangler.copyAttributeValues(prim2->getVertexOffset(2), prim_vtoffs(2));
+		prim2->setVertexPoint(3, new_ptof + 1);
+		twrangler.lerpAttributeValues(prim2->getVertexOffset(3), prim_vtoffs(2), prim_vtoffs(3), 0.5);
+	}
+
+	if (inherit_attribs != 0) {
+		prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, prim1->getMapOffset(), GA_ATTRIB_PRIMITIVE, source_prim->getMapOffset());
+		prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, prim2->getMapOffset(), GA_ATTRIB_PRIMITIVE, source_prim->getMapOffset());
+	}
+
+	result.append((GEO_Primitive*)prim1);
+	result.append((GEO_Primitive*)prim2);
+	kill_prims.append(source_prim);
+}
+
+void Generator::divide(GEO_Primitive * prim, UT_ValArray<GEO_Primitive*>& result)
+{
+	unsigned short dir = SYStrunc(SYSrandom(my_seed) * 2);
+	auto prim_to_split = prim;
+	split_primitive(prim_to_split, result, dir);
+
+	auto nr = my_seed * 1999;
+	unsigned short index = SYStrunc(SYSrandom(nr) * 2);
+	prim_to_split = result(index);
+	result.removeIndex(index);
+	split_primitive(prim_to_split, result, (1 - dir));
+	if (inherit_attribs != 0) {
+		for (auto &new_prim : result) {
+			prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, new_prim->getMapOffset(), GA_ATTRIB_PRIMITIVE, prim->getMapOffset());
+		}
+	}
+}
+
+GEO_Primitive* Generator::extrude(GEO_Primitive * source_prim, const fpreal & height, const fpreal &inset, const fpreal &bevel_size)
+{
+	UT_Vector3 primN = source_prim->computeNormal();
+	UT_Vector4 primP;
+	source_prim->evaluateInteriorPoint(primP, 0.5, 0.5);
+	UT_Vector3 top_center = primP + primN * height;
+	GA_VertexWrangler vtxwrangler(*gdp);
+	UT_Array<GEO_PrimPoly*> resulted_prims;
+	GA_Size numvertex = source_prim->getVertexCount();
+	GA_RWHandleV3D uvhandle;
+	UVFrame uv_frame;
+	if (unwrap_uvs != 0) {
+		uvhandle = uvattr;
+		uv_frame.init(source_prim, uvattr);
+	}
+
+	// One ring of top points per bevel profile row, the last one carries the cap
+	bool bevelled = !bevel_profile.is_flat() && bevel_size > 0.0;
+	exint num_rings = bevelled ? bevel_profile.num_rows() : 1;
+	UT_Vector3Array base_pos(numvertex, numvertex), top_pos(numvertex, numvertex), inset_dir(numvertex, numvertex);
+	UT_Vector3Array wall_top(numvertex, numvertex);
+	for (GA_Size i = 0; i < numvertex; i++)
+		base_pos(i) = phandle.get(gdp->vertexPoint(source_prim->getVertexOffset(i)));
+	// Don't let the cap ring fold over the panel center
+	fpreal size = hreeble::inset_ring(reinterpret_cast<const fpreal32*>(base_pos.data()), numvertex, primN.data(), top_center.data(),
+									  height, inset, bevelled ? SYSmin(bevel_size, height) : 0.0,
+									  reinterpret_cast<fpreal32*>(top_pos.data()), reinterpret_cast<fpreal32*>(inset_dir.data()));
+	GA_Offset point_block = gdp->appendPointBlock(numvertex * num_rings);
+	for (GA_Size i = 0; i < numvertex; i++) {
+		for (exint r = 0; r < num_rings; r++) {
+			UT_Vector3 ring_pos = top_pos(i);
+			if (bevelled)
+				ring_pos += inset_dir(i) * (bevel_profile.inset(r) * size) - primN * (bevel_profile.drop(r) * size);
+			phandle.set(point_block + i*num_rings + r, ring_pos);
+			if (r == 0)
+				wall_top(i) = ring_pos;
+		}
+	}
+	// Bevel bands are laid out around the cap in uv, scaled to their length along the profile
+	UT_Array<UT_Vector3R> uv_shift;
+	if (unwrap_uvs != 0) {
+		fpreal uv_per_world = SYSsqrt(uv_frame.ratio());
+		uv_shift.setSize(numvertex);
+		for (GA_Size i = 0; i < numvertex; i++) {
+			uv_shift(i) = uv_frame.host_uv(i) - uv_frame.center();
+			uv_shift(i).z() = 0.0;
+			uv_shift(i).normalize();
+			uv_shift(i) *= size * uv_per_world;
+		}
+	}
+
+	auto VtxToPt = [this, source_prim](const GA_Size &index) {return gdp->vertexPoint(source_prim->getVertexOffset(index)); };
+	for (GA_Size i = 0;i < numvertex; i++) {
+		bool last = (i == numvertex - 1 ? true : false);
+		GA_Size next = last ? 0 : i + 1;
+		GA_Offset pt0 = VtxToPt(i);
+		GA_Offset pt1 = VtxToPt(next);
+		GA_Offset pt2 = point_block + next*num_rings;
+		GA_Offset pt3 = point_block + i*num_rings;
+
+		auto new_prim = GEO_PrimPoly::build(gdp, 4, false, false);
+		resulted_prims.append(new_prim);
+		new_prim->setVertexPoint(0, pt0);
+		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(0), source_prim->getVertexOffset(i));
+	
+		new_prim->setVertexPoint(1, pt1);
+		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(1), source_prim->getVertexOffset(next));
+		
+		new_prim->setVertexPoint(2, pt2);
+		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(2), new_prim->getVertexOffset(1));
+		
+		new_prim->setVertexPoint(3, pt3);
+		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(3), new_prim->getVertexOffset(0));
+
+		if (unwrap_uvs != 0) {
+			UT_Vector3R uv0 = uv_frame.host_uv(i) + uv_shift(i) * bevel_profile.arc(0);
+			UT_Vector3R uv1 = uv_frame.host_uv(next) + uv_shift(next) * bevel_profile.arc(0);
+			// Area of the wall quad from its diagonals
+			fpreal wall_area = 0.5 * cross(wall_top(next) - base_pos(i), wall_top(i) - base_pos(next)).length();
+			UT_Vector3R offset = uv_frame.wall_offset(uv0, uv1, wall_area);
+			uvhandle.set(new_prim->getVertexOffset(0), uv0 + offset);
+			uvhandle.set(new_prim->getVertexOffset(1), uv1 + offset);
+			uvhandle.set(new_prim->getVertexOffset(2), uv1);
+			uvhandle.set(new_prim->getVertexOffset(3), uv0);
+		}
+		UT_Vector3 edge_dir = base_pos(next) - base_pos(i);
+		if (normal_handle.isValid())
+			hreeble::set_vertex_frame(normal_handle, tangent_handle, new_prim, primN, edge_dir);
+
+		for (exint r = 0; r + 1 < num_rings; r++) {
+			auto bevel_prim = GEO_PrimPoly::build(gdp, 4, false, false);
+			resulted_prims.append(bevel_prim);
+			const GA_Size corners[] = { i, next, next, i };
+			for (int j = 0; j < 4; j++) {
+				exint ring = r + (j < 2 ? 0 : 1);
+				bevel_prim->setVertexPoint(j, point_block + corners[j]*num_rings + ring);
+				vtxwrangler.copyAttributeValues(bevel_prim->getVertexOffset(j), source_prim->getVertexOffset(corners[j]));
+				if (unwrap_uvs != 0)
+					uvhandle.set(bevel_prim->getVertexOffset(j), uv_frame.host_uv(corners[j]) + uv_shift(corners[j]) * bevel_profile.arc(ring));
+			}
+			if (normal_handle.isValid())
+				hreeble::set_vertex_frame(normal_handle, tangent_handle, bevel_prim, primN, edge_dir);
+		}
+		
+	}
+		auto top_prim = GEO_PrimPoly::build(gdp, numvertex, false, false);
+		resulted_prims.append(top_prim);
+		for (int i = 0; i < numvertex; i++) {
+			top_prim->setVertexPoint(i, point_block + i*num_rings + num_rings - 1);
+			vtxwrangler.copyAttributeValues(top_prim->getVertexOffset(i), source_prim->getVertexOffset(i));
+		}
+		if (normal_handle.isValid())
+			hreeble::set_vertex_frame(normal_handle, tangent_handle, top_prim, primN, base_pos(1) - base_pos(0));
+		if (watertight == WatertightModes::CAP_BASES) {
+			// The panel footprint stays as its closed bottom
+			source_prim->reverse();
+			if (normal_handle.isValid())
+				hreeble::set_vertex_frame(normal_handle, tangent_handle, source_prim, -primN, base_pos(1) - base_pos(0));
+		}
+		else
+			kill_prims.append(source_prim);
+		if (inherit_attribs != 0) {
+			for (auto &new_prim : resulted_prims) {
+				prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, new_prim->getMapOffset(), GA_ATTRIB_PRIMITIVE, source_prim->getMapOffset());
+			}
+	}
+		return static_cast<GEO_Primitive*>(top_prim);
+
+}
+
+ElementLOD Generator::element_lod(Element &element, const GEO_Primitive *prim)
+{
+	UT_Vector3 center;
+	fpreal size = element.world_size(prim, center);
+	if (lod_mode == LODModes::CAMERA)
+		size /= SYSmax((center - lod_camera).length(), fpreal(1e-6));
+	if (size < lod_cull_size)
+		return ElementLOD::CULL;
+	if (size < lod_cap_size)
+		return ElementLOD::CAP;
+	return ElementLOD::FULL;
+}
+
+std::unique_ptr<Element> Generator::create_element(const uint &shape, const short &dir, CoordStore *coords)
+{
+	// Shape codes from CUSTOM on index the loaded library
+	std::unique_ptr<Element> element;
+	if (shape >= uint(ElementTypes::CUSTOM))
+		element = make_library_element(*shape_library, shape - uint(ElementTypes::CUSTOM), dir,
+									   inherit_attribs, unwrap_uvs, prim_refmap, uvattr,
+									   elements_group, elements_front_group, coords);
+	else
+		element = make_element(static_cast<ElementTypes>(shape), dir, inherit_attribs, unwrap_uvs, prim_refmap, uvattr,
+							   elements_group, elements_front_group, coords);
+	element->atlas = pack_uvs ? &uv_atlas : nullptr;
+	element->normal_handle = normal_handle;
+	element->tangent_handle = tangent_handle;
+	element->base_rings = watertight == WatertightModes::STITCH ? &host_rings : nullptr;
+	element->cap_base = watertight == WatertightModes::CAP_BASES;
+	return element;
+}
+
+std::unique_ptr<Element> Generator::place_element(const UT_ValArray<uint> &shapes, const uint &host_seed, const uint &index, const GA_Size &num_vtx,
+												   const fpreal &height_scale, const fpreal &face_scale, fpreal &height, CoordStore *coords)
+{
+	uint elem_seed = host_seed + index * 12987;
+	uint shape;
+	if (num_vtx == 3)
+		shape = uint(ElementTypes::TRIANGLE);
+	else
+		shape = hreeble::rand_choice(shapes, elem_seed);
+	height = SYSfit01((fpreal64)SYSfastRandom(elem_seed), parms->elem_height[0], parms->elem_height[1]) * height_scale;
+	UT_Vector2R elem_pos(SYSfastRandom(elem_seed), SYSfastRandom(elem_seed));
+	fpreal elem_scale = SYSfit01((fpreal64)SYSfastRandom(elem_seed), parms->elem_scale[0], parms->elem_scale[1]) * face_scale;
+	auto element = create_element(shape, (short)hreeble::rand_bool(elem_seed), coords);
+	element->transform(elem_pos, elem_scale, hreeble::rand_bool(elem_seed + 11234));
+	return element;
+}
+
+exint Generator::num_tier0_hosts(const GA_Size &num_vtx) const
+{
+	// Quads divide into three panels, the rest host elements only as triangles and quads
+	if (parms->generate_panels != 0 && num_vtx == 4)
+		return 3;
+	return (num_vtx == 3 || num_vtx == 4) ? 1 : 0;
+}
+
+void Generator::plan_faces(const exint &start, const exint &end, const GA_OffsetList &source_prims, const UT_Array<exint> &face_ids,
+						   const UT_ValArray<uint> &selected_shapes)
+{
+	exint num_faces = end - start;
+	face_plans.clear();
+	face_plans.resize(num_faces);
+	fpreal total_cost = 0.0;
+	for (exint f = 0; f < num_faces; f++) {
+		FacePlan &plan = face_plans[f];
+		exint src = start + f;
+		plan.density = parms->elem_density;
+		if (face_densities.entries() != 0) {
+			// Zero turns a face off, the top of the parameter range bounds the rest. NaN reads as zero.
+			fpreal32 density = SYSrint(face_densities(src));
+			uint max_density = SYSmax(MAX_ELEM_DENSITY, parms->elem_density);
+			plan.density = density > 0.0f ? uint(SYSmin(density, fpreal32(max_density))) : 0;
+		}
+		plan.scale = face_scales.entries() != 0 ? face_scales(src) : 1.0;
+		plan.height = face_heights.entries() != 0 ? face_heights(src) : 1.0;
+		// Mask bits follow Element Shapes, the CUSTOM bit keeps library shapes
+		fpreal shape_cost = 0.0;
+		for (exint s = 0; s < selected_shapes.entries(); s++) {
+			uint shape = selected_shapes(s);
+			uint bit = shape >= uint(ElementTypes::CUSTOM) ? uint(ElementTypes::CUSTOM) : shape;
+			if (face_masks.entries() != 0 && (uint(exint(face_masks(src))) & bit) == 0)
+				continue;
+			plan.shapes.append(shape);
+			shape_cost += shape_costs(s);
+		}
+		GA_Size num_vtx = gdp->getPrimitive(source_prims(src))->getVertexCount();
+		exint hosts = num_tier0_hosts(num_vtx);
+		if (plan.shapes.entries() != 0)
+			shape_cost /= plan.shapes.entries();
+		plan.cost = 1.0 + hosts * (1.0 + plan.density * shape_cost * parms->elem_tiers);
+		total_cost += plan.cost;
+	}
+
+	// Equal cost tasks, a few per thread so stealing evens out what the estimate misses
+	exint num_tasks = SYSmin(num_faces, exint(UT_Thread::getNumProcessors()) * TASKS_PER_THREAD);
+	plan_tasks.clear();
+	plan_tasks.append(0);
+	fpreal task_cost = total_cost / SYSmax(num_tasks, exint(1)), cost = 0.0;
+	for (exint f = 0; f < num_faces; f++) {
+		cost += face_plans[f].cost;
+		if (cost >= task_cost * plan_tasks.entries() && f + 1 < num_faces)
+			plan_tasks.append(f + 1);
+	}
+	plan_tasks.append(num_faces);
+	// Elements of the last batch are gone, their stores can move
+	if (task_coords.size() < size_t(plan_tasks.entries() - 1))
+		task_coords.resize(plan_tasks.entries() - 1);
+
+	UTparallelFor(UT_BlockedRange<exint>(0, plan_tasks.entries() - 1), [&](const UT_BlockedRange<exint> &range) {
+		for (exint task = range.begin(); task != range.end(); ++task) {
+			// The cost estimate roughly counts outline points
+			CoordStore &coords = task_coords[task];
+			fpreal points = 0.0;
+			for (exint f = plan_tasks(task); f < plan_tasks(task + 1); f++)
+				points += face_plans[f].cost;
+			coords.clear();
+			coords.xs.setCapacityIfNeeded(exint(points));
+			coords.ys.setCapacityIfNeeded(exint(points));
+			for (exint f = plan_tasks(task); f < plan_tasks(task + 1); f++) {
+				FacePlan &plan = face_plans[f];
+				exint src = start + f;
+				if (plan.shapes.entries() == 0)
+					continue;
+				GA_Size num_vtx = gdp->getPrimitive(source_prims(src))->getVertexCount();
+				exint hosts = num_tier0_hosts(num_vtx);
+				uint face_seed = hreeble::face_seed(parms->seed, face_ids(src));
+				plan.elements.reserve(hosts * plan.density);
+				plan.heights.reserve(hosts * plan.density);
+				for (exint h = 0; h < hosts; h++) {
+					uint host_seed = face_seed + uint(h) * 130145;
+					for (uint i = 0; i < plan.density; i++) {
+						fpreal height;
+						plan.elements.push_back(place_element(plan.shapes, host_seed, i, num_vtx, plan.height, plan.scale, height, &coords));
+						plan.heights.push_back(height);
+					}
+				}
+			}
+		}
+	}, 2, 1);
+}
+
+bool Generator::build_buffered(const exint &num_faces, UT_AutoInterrupt *boss)
+{
+	// Triangulations are cached on first use, fill the cache before going wide
+	std::vector<std::vector<const UT_IntArray*>> caps(num_faces);
+	for (exint f = 0; f < num_faces; f++) {
+		for (const auto &element : face_plans[f].elements)
+			caps[f].push_back(cap_triangles(*element));
+	}
+
+	// One buffer per planned task, so the spliced order never depends on scheduling
+	exint num_tasks = plan_tasks.entries() - 1;
+	std::vector<std::unique_ptr<ElementBuffer>> buffers(num_tasks);
+	// Every task polls, one seeing an interrupt stops the others at their next element
+	std::atomic<bool> stop(false);
+	UTparallelFor(UT_BlockedRange<exint>(0, num_tasks), [&](const UT_BlockedRange<exint> &range) {
+		for (exint task = range.begin(); task != range.end() && !stop; ++task) {
+			buffers[task].reset(new ElementBuffer(*gdp, unwrap_uvs != 0 ? uvattr : nullptr, normal_handle.getAttribute(),
+												  tangent_handle.getAttribute(), elements_group, elements_front_group, inherit_attribs != 0));
+			ElementBuffer &buffer = *buffers[task];
+			exint num_elements = 0;
+			for (exint f = plan_tasks(task); f < plan_tasks(task + 1) && !stop; f++) {
+				FacePlan &plan = face_plans[f];
+				for (exint h = 0; h < plan.hosts.entries() && !stop; h++) {
+					const GEO_Primitive *prim = plan.hosts(h);
+					UT_Vector3 primN = prim->computeNormal();
+					for (uint i = 0; i < plan.density; i++) {
+						size_t slot = size_t(h) * plan.density + i;
+						if (slot >= plan.elements.size())
+							break;
+						if ((++num_elements % INTERRUPT_BATCH) == 0 && (stop || was_interrupted(boss, -1))) {
+							stop = true;
+							break;
+						}
+						Element &element = *plan.elements[slot];
+						fpreal elem_height = plan.heights[slot];
+						ElementLOD lod = ElementLOD::FULL;
+						if (lod_mode != LODModes::OFF)
+							lod = element_lod(element, prim);
+						if (lod == ElementLOD::CULL)
+							continue;
+						// Capped bases need walls
+						if (watertight != WatertightModes::OFF)
+							lod = ElementLOD::FULL;
+						buffer.bind(element);
+						bool merged = lod == ElementLOD::CAP && element.merge_subelements();
+						element.build(buffer.detail(), prim, primN, elem_height, lod == ElementLOD::FULL,
+									  merged ? nullptr : caps[f][slot], &bevel_profile, parms->elem_bevel * elem_height);
+					}
+				}
+				plan.elements.clear();
+			}
+		}
+	}, 2, 1);
+	// The cook is rolled back, nothing of the batch goes in
+	if (stop)
+		return false;
+	ElementBuffer::splice(gdp, buffers);
+	return true;
+}
+
+std::unique_ptr<Element> Generator::prototype_element(const Element &element)
+{
+	// Untransformed (shape, direction, flip) of an element
+	uint shape = uint(element.get_type());
+	if (element.get_type() == ElementTypes::CUSTOM)
+		shape += element.get_library_shape();
+	auto proto_elem = create_element(shape, element.get_direction());
+	if (element.is_flipped())
+		proto_elem->flip();
+	return proto_elem;
+}
+
+const UT_IntArray* Generator::cap_triangles(const Element &element)
+{
+	// Caps with holes can't be a single polygon
+	if (!triangulate_caps && !element.has_holes())
+		return nullptr;
+	UT_IntArray &triangles = triangulations(element.prototype_key());
+	if (triangles.entries() == 0)
+		prototype_element(element)->triangulate(triangles);
+	return triangles.entries() != 0 ? &triangles : nullptr;
+}
+
+void Generator::instance_element(Element &element, const GEO_Primitive *prim, const UT_Vector3 &primN, const fpreal &height)
+{
+	UT_Matrix3D xform;
+	UT_Vector3D pos;
+	exint key = element.prototype_key();
+	element.instance_xform(prim, primN, height, xform, pos);
+	if (output_mode == OutputModes::PACKED) {
+		GU_DetailHandle &proto = prototypes(key);
+		if (!proto.isValid()) {
+			// Build each prototype once per cook, every placement shares it
+			GU_Detail *proto_gdp = new GU_Detail();
+			prototype_element(element)->build_prototype(proto_gdp, cap_triangles(element));
+			proto.allocateAndSet(proto_gdp);
+		}
+		GU_PrimPacked *packed = GU_PackedGeometry::packGeometry(*gdp, proto);
+		packed->setLocalTransform(xform);
+		gdp->setPos3(packed->getPointOffset(0), UT_Vector3(pos));
+		if (inherit_attribs != 0)
+			prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, packed->getMapOffset(), GA_ATTRIB_PRIMITIVE, prim->getMapOffset());
+		if (elements_group != nullptr)
+			elements_group->add(packed);
+	}
+	else {
+		// Orthonormal frame for orient, the remaining stretch goes to scale
+		UT_Vector3D x(xform(0, 0), xform(0, 1), xform(0, 2));
+		UT_Vector3D y(xform(1, 0), xform(1, 1), xform(1, 2));
+		UT_Vector3D z(primN);
+		UT_Vector3 scale(x.length(), y.length(), height);
+		z.normalize();
+		x.normalize();
+		y = cross(z, x);
+		y.normalize();
+		x = cross(y, z);
+		UT_Matrix3D rot(x.x(), x.y(), x.z(),
+						y.x(), y.y(), y.z(),
+						z.x(), z.y(), z.z());
+		UT_QuaternionD orient;
+		orient.updateFromRotationMatrix(rot);
+
+		GA_Offset ptoff = gdp->appendPointOffset();
+		gdp->setPos3(ptoff, UT_Vector3(pos));
+		orient_handle.set(ptoff, UT_QuaternionF(orient));
+		scale_handle.set(ptoff, scale);
+		height_handle.set(ptoff, height);
+		shape_handle.set(ptoff, key);
+	}
+}
+
+void Generator::stitch_host(GEO_Primitive *host, const UT_Array<BaseRing> &rings)
+{
+	// Retriangulate the host around the element bases in its own plane, every point is shared
+	GA_Size num_vtx = host->getVertexCount();
+	UT_Vector3 N = host->computeNormal();
+	UT_Vector3 origin = phandle.get(host->getPointOffset(0));
+	UT_Vector3 t = phandle.get(host->getPointOffset(1)) - origin;
+	t.normalize();
+	UT_Vector3 b = cross(N, t);
+	UT_Array<fpreal32> xs, ys;
+	GA_OffsetArray points;
+	UT_Array<UT_Vector2R> coords;
+	auto add_point = [&](const GA_Offset &ptof, const UT_Vector2R &coord) {
+		UT_Vector3 d = phandle.get(ptof) - origin;
+		xs.append(d.dot(t));
+		ys.append(d.dot(b));
+		points.append(ptof);
+		coords.append(coord);
+		return int(points.entries() - 1);
+	};
+	auto signed_area = [&](const UT_IntArray &outline) {
+		fpreal area = 0.0;
+		for (exint i = 0; i < outline.entries(); i++) {
+			int p = outline(i), q = outline((i + 1) % outline.entries());
+			area += fpreal(xs(p)) * ys(q) - fpreal(xs(q)) * ys(p);
+		}
+		return area;
+	};
+
+	GA_VertexWrangler vtxwrangler(*gdp);
+	GA_PrimitiveWrangler primwrangler(*gdp);
+	bool front = elements_front_group != nullptr && elements_front_group->containsOffset(host->getMapOffset());
+	auto emit = [&](const UT_IntArray &triangles) {
+		for (exint i = 0; i < triangles.entries(); i += 3) {
+			auto tri = GEO_PrimPoly::build(gdp, 3, false, false);
+			for (int j = 0; j < 3; j++) {
+				int index = triangles(i + j);
+				tri->setVertexPoint(j, points(index));
+				if (index < num_vtx)
+					vtxwrangler.copyAttributeValues(tri->getVertexOffset(j), host->getVertexOffset(index));
+				else
+					host->evaluateInteriorPoint(tri->getVertexOffset(j), vertex_refmap, coords(index).x(), coords(index).y());
+			}
+			primwrangler.copyAttributeValues(tri->getMapOffset(), host->getMapOffset());
+			if (front)
+				elements_front_group->add(tri);
+			if (normal_handle.isValid())
+				hreeble::set_vertex_frame(normal_handle, tangent_handle, tri, N, t);
+		}
+	};
+
+	UT_Array<UT_IntArray> outlines;
+	outlines.append();
+	for (GA_Size v = 0; v < num_vtx; v++)
+		outlines(0).append(add_point(host->getPointOffset(v), UT_Vector2R(0.0, 0.0)));
+	bool host_ccw = signed_area(outlines(0)) > 0.0;
+	for (const auto &ring : rings) {
+		if (ring.hole)
+			continue;
+		UT_IntArray outline;
+		for (exint i = 0; i < ring.points.entries(); i++)
+			outline.append(add_point(ring.points(i), ring.coords(i)));
+		outlines.append(outline);
+	}
+	UT_IntArray triangles;
+	if (!hreeble::triangulate(xs.data(), ys.data(), outlines, triangles))
+		return;
+	emit(triangles);
+
+	// The host shows through element holes
+	for (const auto &ring : rings) {
+		if (!ring.hole)
+			continue;
+		UT_Array<UT_IntArray> hole_outline;
+		hole_outline.append();
+		for (exint i = 0; i < ring.points.entries(); i++)
+			hole_outline(0).append(add_point(ring.points(i), ring.coords(i)));
+		if ((signed_area(hole_outline(0)) > 0.0) != host_ccw)
+			hole_outline(0).reverse();
+		triangles.clear();
+		if (hreeble::triangulate(xs.data(), ys.data(), hole_outline, triangles))
+			emit(triangles);
+	}
+	kill_prims.append(host);
+}
+
+void Generator::destroy_kill_prims()
+{
+	for (auto prim : kill_prims) {
+		gdp->destroyPrimitive((*prim), true);
+	}
+	kill_prims.clear();
+}
+
+void Generator::read_face_attrib(const char *name, const GA_OffsetList &faces, UT_Array<fpreal32> &values)
+{
+	// Control values per source face, read a page at a time. Point values are averaged over the face.
+	values.clear();
+	const GA_Attribute *attr = gdp->findPrimitiveAttribute(name);
+	if (attr != nullptr) {
+		GA_ROPageHandleF ph(attr);
+		if (!ph.isValid())
+			return;
+		values.setSize(faces.entries());
+		GA_PageNum page = GA_INVALID_INDEX;
+		for (exint i = 0; i < faces.entries(); i++) {
+			GA_Offset off = faces(i);
+			if (GAgetPageNum(off) != page) {
+				page = GAgetPageNum(off);
+				ph.setPage(off);
+			}
+			values(i) = ph.value(off);
+		}
+		return;
+	}
+	attr = gdp->findPointAttribute(name);
+	if (attr == nullptr)
+		return;
+	GA_ROPageHandleF ph(attr);
+	if (!ph.isValid())
+		return;
+	UT_Array<fpreal32> point_values;
+	point_values.setSize(gdp->getNumPoints());
+	GA_Offset start, end;
+	for (GA_Iterator it(gdp->getPointRange()); it.blockAdvance(start, end); ) {
+		ph.setPage(start);
+		for (GA_Offset off = start; off < end; ++off)
+			point_values(gdp->pointIndex(off)) = ph.value(off);
+	}
+	values.setSize(faces.entries());
+	for (exint i = 0; i < faces.entries(); i++) {
+		const GA_Primitive *face = gdp->getPrimitive(faces(i));
+		GA_Size num_vtx = face->getVertexCount();
+		fpreal32 sum = 0.0f;
+		for (GA_Size v = 0; v < num_vtx; v++)
+			sum += point_values(gdp->pointIndex(face->getPointOffset(v)));
+		values(i) = num_vtx > 0 ? sum / num_vtx : 0.0f;
+	}
+}
+
+exint Generator::chunk_size(const exint &num_source_prims, const uint &element_density, const uint &num_shapes, const uint &generate_panels)
+{
+	exint size = num_source_prims;
+	if (parms->chunked_cook == 0)
+		return SYSmax(size, exint(1));
+	size = SYSmin(size, parms->chunk_size);
+	fpreal budget = parms->memory_budget;
+	if (budget > 0.0) {
+		exint hosts = generate_panels != 0 ? 3 : 1;
+		exint face_bytes = PANEL_BYTES * (generate_panels != 0 ? hosts : 0);
+		if (num_shapes != 0)
+			face_bytes += ELEMENT_BYTES * hosts * element_density;
+		exint budget_size = exint(budget * 1024.0 * 1024.0) / SYSmax(face_bytes, exint(1));
+		size = SYSmin(size, budget_size);
+	}
+	return SYSmax(size, exint(1));
+}
+
+GeneratorResult Generator::generate(GU_Detail *detail, const GA_PrimitiveGroup *source_group, const GeneratorParms &p)
+{
+	gdp = detail;
+	parms = &p;
+	error_msg.clear();
+	warning_msg.clear();
+	uint seed_parm = p.seed;
+	const fpreal *panel_height_parm = p.panel_height;
+	fpreal panel_inset_parm = p.panel_inset;
+	uint element_density = p.elem_density;
+	uint shapes_parm = p.shapes;
+	uint generate_panels = p.generate_panels;
+	unwrap_uvs = p.unwrap_uvs;
+	inherit_attribs = p.inherit_attribs;
+	output_mode = p.output_mode;
+	lod_mode = p.lod_mode;
+	lod_camera = p.lod_camera;
+	lod_cap_size = p.lod_cap_size;
+	lod_cull_size = p.lod_cull_size;
+	// Triangle output takes the cached cap triangulations, walls are split at the end
+	triangulate_caps = p.cap_triangles != 0 || output_mode == OutputModes::TRIANGLES;
+	fpreal elem_bevel_parm = p.elem_bevel;
+	fpreal panel_bevel_parm = p.panel_bevel;
+	// One profile table per cook, scaled by every element and panel height
+	uint num_tiers = SYSmax(p.elem_tiers, 1u);
+	fpreal tier_falloff = p.tier_falloff;
+	bevel_profile.set(p.bevel_shape, (elem_bevel_parm > 0.0 || panel_bevel_parm > 0.0) ? p.bevel_segments : 0);
+
+	UT_ValArray<uint> selected_shapes;
+	// Higher bits would collide with library shape codes
+	for (uint i = 0; i < NUM_SELECTABLE_SHAPES; i++) {
+		if ((shapes_parm & (0x01 << i)) != 0) {
+			selected_shapes.append(0x01 << i);
+		}
+	}
+	UT_String library_pattern(p.library_shapes.c_str());
+	shape_library.reset();
+	if (!p.shape_library.empty()) {
+		shape_library = ShapeLibrary::load(p.shape_library.c_str(), error_msg);
+		if (!shape_library)
+			return GeneratorResult::FAILED;
+		for (exint i = 0; i < shape_library->num_shapes(); i++) {
+			UT_String shape_name(shape_library->name(i));
+			if (shape_name.multiMatch(library_pattern))
+				selected_shapes.append(uint(ElementTypes::CUSTOM) + i);
+		}
+	}
+
+	// Background runs have no interrupt dialog, cancel() stops them
+	std::unique_ptr<UT_AutoInterrupt> boss;
+	if (interruptible)
+		boss.reset(new UT_AutoInterrupt("Making hreeble..."));
+	phandle = gdp->getP();
+	if (p.convex == 1)
+		gdp->convex(GA_Size(4));
+	uint num_selected_shapes = selected_shapes.entries();
+	if (num_selected_shapes == 0 && generate_panels == 0) return GeneratorResult::DONE;
+	elements_group = nullptr;
+	elements_front_group = nullptr;
+	if (p.create_groups != 0) {
+		elements_group = gdp->newPrimitiveGroup("elements");
+		elements_front_group = gdp->newPrimitiveGroup("elements_front");
+	}
+	if (unwrap_uvs != 0) {
+		uvattr = gdp->findTextureAttribute(GA_ATTRIB_VERTEX);
+		if (!uvattr) {
+			error_msg.harden("Please assign vertex UVs on source geometry");
+			return GeneratorResult::FAILED;
+		}
+	}
+	pack_uvs = p.pack_uvs != 0 && polygon_output() && num_selected_shapes != 0;
+	uv_atlas.clear();
+	if (pack_uvs) {
+		uvattr = gdp->findTextureAttribute(GA_ATTRIB_VERTEX);
+		if (!uvattr)
+			uvattr = gdp->addTextureAttribute(GA_ATTRIB_VERTEX);
+	}
+	normal_handle.clear();
+	tangent_handle.clear();
+	if (p.output_normals != 0) {
+		// Faces carried over from the input get their flat normal unless they already have vertex normals
+		bool has_normals = gdp->findNormalAttribute(GA_ATTRIB_VERTEX) != nullptr;
+		bool has_tangents = gdp->findFloatTuple(GA_ATTRIB_VERTEX, "tangentu", 3) != nullptr;
+		normal_handle = gdp->addNormalAttribute(GA_ATTRIB_VERTEX);
+		tangent_handle = gdp->addFloatTuple(GA_ATTRIB_VERTEX, "tangentu", 3);
+		tangent_handle.getAttribute()->setTypeInfo(GA_TYPE_VECTOR);
+		for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd() && !(has_normals && has_tangents); ++it) {
+			GEO_Primitive *prim = gdp->getGEOPrimitive(*it);
+			if (prim->getVertexCount() < 2)
+				continue;
+			UT_Vector3 N = prim->computeNormal();
+			UT_Vector3 T = phandle.get(prim->getPointOffset(1)) - phandle.get(prim->getPointOffset(0));
+			T -= N * T.dot(N);
+			T.normalize();
+			for (GA_Size i = 0; i < prim->getVertexCount(); i++) {
+				if (!has_normals)
+					normal_handle.set(prim->getVertexOffset(i), N);
+				if (!has_tangents)
+					tangent_handle.set(prim->getVertexOffset(i), T);
+			}
+		}
+	}
+	// Stitching interpolates every vertex attribute of the host at the element base
+	watertight = polygon_output() ? p.watertight : WatertightModes::OFF;
+	vertex_refmap.clear();
+	vertex_refmap.bind(*gdp, *gdp);
+	if (watertight == WatertightModes::STITCH) {
+		for (GA_AttributeDict::iterator it = gdp->vertexAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+			vertex_refmap.appendDest(it.attrib());
+		}
+	}
+	exint num_prototypes = (NUM_BUILTIN_SHAPES + (shape_library ? shape_library->num_shapes() : 0)) * PROTOTYPE_VARIANTS;
+	prototypes.clear();
+	prototypes.setSize(num_prototypes);
+	triangulations.clear();
+	triangulations.setSize(num_prototypes);
+	if (output_mode == OutputModes::POINTS && num_selected_shapes != 0) {
+		GA_Attribute *orient_attr = gdp->addFloatTuple(GA_ATTRIB_POINT, "orient", 4);
+		orient_attr->setTypeInfo(GA_TYPE_QUATERNION);
+		orient_handle = orient_attr;
+		scale_handle = gdp->addFloatTuple(GA_ATTRIB_POINT, "scale", 3);
+		height_handle = gdp->addFloatTuple(GA_ATTRIB_POINT, "hreeble_height", 1);
+		shape_handle = gdp->addIntTuple(GA_ATTRIB_POINT, "hreeble_shape", 1);
+	}
+	UT_ValArray<GEO_Primitive*> panel_prims;
+	UT_ValArray<GEO_Primitive*> top_prims;
+	UT_ValArray<GEO_Primitive*> tier_caps;
+	kill_prims.clear();
+	fpreal panel_height = 0.0;
+	GA_OffsetList source_prims;
+	for (GA_Iterator it(gdp->getPrimitiveRange(source_group)); !it.atEnd(); ++it) {
+		source_prims.append(*it);
+	}
+	exint num_source_prims = source_prims.entries();
+	// Seeds come from a stable id per source face, so a face greebles the same in any order or partition
+	UT_Array<exint> face_ids;
+	face_ids.setCapacity(num_source_prims);
+	GA_Attribute *face_id_attr = gdp->findPrimitiveAttribute(FACE_ID_ATTRIB);
+	GA_ROHandleI face_id_handle(face_id_attr);
+	for (exint i = 0; i < num_source_prims; i++)
+		face_ids.append(face_id_handle.isValid() ? exint(face_id_handle.get(source_prims(i))) : exint(gdp->primitiveIndex(source_prims(i))));
+	if (face_id_attr)
+		gdp->destroyAttribute(face_id_attr);
+	// Bound after the face ids are gone, they must not be inherited
+	prim_refmap.bind(*gdp, *gdp);
+	if (inherit_attribs != 0) {
+		for (GA_AttributeDict::iterator it = gdp->primitiveAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+			prim_refmap.appendDest(it.attrib());
+		}
+	}
+	read_face_attrib("hreeble_density", source_prims, face_densities);
+	read_face_attrib("hreeble_scale", source_prims, face_scales);
+	read_face_attrib("hreeble_height", source_prims, face_heights);
+	read_face_attrib("hreeble_mask", source_prims, face_masks);
+	shape_costs.clear();
+	for (const auto &shape : selected_shapes) {
+		auto element = create_element(shape, 0);
+		shape_costs.append(fpreal(element->subelem_start(element->num_subelements())));
+	}
+	exint chunk = chunk_size(num_source_prims, element_density, num_selected_shapes, generate_panels);
+	// Single tier polygons whose hosts are independent build into buffers in parallel.
+	// Atlas charts and stitching record target offsets, tiers host on fresh caps.
+	bool buffered = polygon_output() && num_selected_shapes != 0 && num_tiers == 1 && !pack_uvs && watertight != WatertightModes::STITCH;
+	// Atlas charts hold vertex offsets until the final pack
+	bool compact = chunk < num_source_prims && !pack_uvs;
+	GA_IndexArray pending_index;
+	if (compact)
+		pending_index.setSize(num_source_prims - chunk);
+	bool interrupted = false;
+	exint num_elements = 0;
+	for (exint chunk_start = 0; chunk_start < num_source_prims && !interrupted; chunk_start += chunk) {
+		exint chunk_end = SYSmin(chunk_start + chunk, num_source_prims);
+		for (exint src = chunk_start; src < chunk_end && !interrupted; src++) {
+			if ((src - chunk_start) % PLAN_BATCH == 0)
+				plan_faces(src, SYSmin(src + PLAN_BATCH, chunk_end), source_prims, face_ids, selected_shapes);
+			FacePlan &plan = face_plans[(src - chunk_start) % PLAN_BATCH];
+			GEO_Primitive *source_prim = static_cast<GEO_Primitive*>(gdp->getPrimitive(source_prims(src)));
+			int percent = int((100 * src) / num_source_prims);
+			uint face_seed = hreeble::face_seed(seed_parm, face_ids(src));
+			my_seed = face_seed;
+			uint num_hosts = 0;
+			top_prims.clear();
+			if (was_interrupted(boss.get(), percent)) {
+				interrupted = true;
+				break;
+			}
+			const UT_ValArray<uint> &shapes = plan.shapes;
+			if (generate_panels != 0) {
+				panel_prims.clear();
+				if (source_prim->getVertexCount() == 4)
+					divide(source_prim, panel_prims); // Divide source prim into panels
+				else if (source_prim->getVertexCount() == 3)
+					panel_prims.append(source_prim);
+				for (auto prim : panel_prims) {
+					panel_height = SYSfit01((fpreal64)SYSfastRandom(my_seed), panel_height_parm[0], panel_height_parm[1]);
+					GEO_Primitive *extruded_front_prim = extrude(prim, panel_height, panel_inset_parm, panel_bevel_parm * panel_height);
+					top_prims.append(extruded_front_prim);
+				}
+			}
+			else {
+				top_prims.append(source_prim);
+			}
+			if (buffered) {
+				// Elements wait until every face of the batch has its panels
+				plan.hosts.clear();
+				for (const auto prim : top_prims) {
+					if (prim->getVertexCount() == 3 || prim->getVertexCount() == 4)
+						plan.hosts.append(prim);
+				}
+				exint batch_face = (src - chunk_start) % PLAN_BATCH;
+				if (batch_face + 1 == PLAN_BATCH || src + 1 == chunk_end)
+					interrupted = !build_buffered(batch_face + 1, boss.get()) || was_interrupted(boss.get(), percent);
+				continue;
+			}
+			// Caps of every tier host the next one, straight from this cook's prims
+			for (uint tier = 0; tier < num_tiers && shapes.entries() != 0 && !interrupted; tier++) {
+				bool last_tier = tier + 1 == num_tiers || !polygon_output();
+				fpreal tier_height = SYSpow(tier_falloff, fpreal(tier));
+				tier_caps.clear();
+				for (const auto prim: top_prims){
+					UT_Vector3 primN = prim->computeNormal();
+					auto num_vtx = prim->getVertexCount();
+					if (num_vtx < 3 || num_vtx > 4)
+						continue;
+					uint host = num_hosts++;
+					uint host_seed = face_seed + host * 130145;
+					host_rings.clear();
+					placed_boxes.clear();
+					for (uint i = 0; i < plan.density && !interrupted; i++) {
+						if ((++num_elements % INTERRUPT_BATCH) == 0 && was_interrupted(boss.get(), percent)) {
+							interrupted = true;
+							break;
+						}
+						std::unique_ptr<Element> element;
+						fpreal elem_height;
+						size_t slot = size_t(host) * plan.density + i;
+						if (tier == 0 && slot < plan.elements.size()) {
+							element = std::move(plan.elements[slot]);
+							elem_height = plan.heights[slot];
+						}
+						else
+							element = place_element(shapes, host_seed, i, num_vtx, tier_height * plan.height, plan.scale, elem_height);
+						ElementLOD lod = ElementLOD::FULL;
+						if (lod_mode != LODModes::OFF)
+							lod = element_lod(*element, prim);
+						if (lod == ElementLOD::CULL)
+							continue;
+						if (watertight != WatertightModes::OFF) {
+							// Closed output needs walls, stitched bases must not overlap in the host
+							lod = ElementLOD::FULL;
+							if (watertight == WatertightModes::STITCH) {
+								BBox2D box = element->bbox();
+								bool overlaps = false;
+								for (const auto &other : placed_boxes) {
+									if (box.minvec.x() < other.maxvec.x() + STITCH_MARGIN && other.minvec.x() < box.maxvec.x() + STITCH_MARGIN
+										&& box.minvec.y() < other.maxvec.y() + STITCH_MARGIN && other.minvec.y() < box.maxvec.y() + STITCH_MARGIN) {
+										overlaps = true;
+										break;
+									}
+								}
+								if (overlaps)
+									continue;
+								placed_boxes.append(box);
+							}
+						}
+						if (polygon_output()) {
+							bool merged = lod == ElementLOD::CAP && element->merge_subelements();
+							element->build(gdp, prim, primN, elem_height, lod == ElementLOD::FULL,
+										   merged ? nullptr : cap_triangles(*element), &bevel_profile, elem_bevel_parm * elem_height,
+										   last_tier ? nullptr : &tier_caps);
+						}
+						else
+							instance_element(*element, prim, primN, elem_height);
+					}
+					if (watertight == WatertightModes::STITCH && !interrupted && host_rings.entries() != 0)
+						stitch_host(prim, host_rings);
+				}
+				if (last_tier)
+					break;
+				top_prims = tier_caps;
+			}
+		}
+		if (interrupted)
+			break;
+		// Release the consumed source and intermediate prims before the next chunk
+		destroy_kill_prims();
+		panel_prims.setCapacity(0);
+		top_prims.setCapacity(0);
+		tier_caps.setCapacity(0);
+		if (compact && chunk_end < num_source_prims) {
+			// Destroyed prims only leave holes, compacting gives their pages back.
+			// Indices of the sources left survive it, offsets don't.
+			for (exint src = chunk_end; src < num_source_prims; src++)
+				pending_index(src - chunk_end) = gdp->primitiveIndex(source_prims(src));
+			gdp->defragment();
+			for (exint src = chunk_end; src < num_source_prims; src++)
+				source_prims.set(src, gdp->primitiveOffset(pending_index(src - chunk_end)));
+		}
+	}
+	if (pack_uvs && !interrupted && uv_atlas.entries() != 0 && !uv_atlas.pack(GA_RWHandleV3D(uvattr), p.uv_tile, ATLAS_PADDING))
+		warning_msg.sprintf("Element uvs didn't fit into tile %d and were left unpacked", p.uv_tile);
+	uv_atlas.clear();
+	if (output_mode == OutputModes::TRIANGLES && !interrupted) {
+		// Walls, panels and hosts are planar, splitting them is all that is left
+		gdp->convex(GA_Size(3));
+		if (!p.mesh_file.empty())
+			hreeble::write_mesh(gdp, p.mesh_file.c_str(), warning_msg);
+	}
+	if (interrupted) {
+		kill_prims.clear();
+		return GeneratorResult::INTERRUPTED;
+	}
+	return GeneratorResult::DONE;
+}
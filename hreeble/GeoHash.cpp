@@ -0,0 +1,418 @@
+#include "GeoHash.h"
+#include <GA/GA_AIFTuple.h>
+#include <GA/GA_GBMacros.h>
+#include <GA/GA_Handle.h>
+#include <UT/UT_ParallelUtil.h>
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+namespace {
+	const GA_AttributeOwner HASHED_OWNERS[] = { GA_ATTRIB_POINT, GA_ATTRIB_VERTEX, GA_ATTRIB_PRIMITIVE, GA_ATTRIB_DETAIL };
+	// Elements per parallel block, one attribute page
+	const exint HASH_BLOCK = GA_PAGE_SIZE;
+
+	inline void append_float(UT_Array<uint32> &words, fpreal32 value)
+	{
+		// -0.0 and 0.0 generate the same geometry
+		if (value == 0.0f)
+			value = 0.0f;
+		uint32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		words.append(bits);
+	}
+
+	inline void append_uint(UT_Array<uint32> &words, const uint64 &value)
+	{
+		words.append(uint32(value));
+		words.append(uint32(value >> 32));
+	}
+
+	inline void append_string(UT_Array<uint32> &words, const char *str)
+	{
+		hreeble::Hasher hash;
+		hash.add_string(str);
+		append_uint(words, hash.value());
+	}
+
+	// Reads the values of one attribute, 32 bit storage through handles
+	class ValueReader
+	{
+	public:
+		ValueReader(const GA_Attribute *attr)
+			:attr(attr), tuple_size(attr->getTupleSize()), tuple(attr->getAIFTuple()),
+			floats(tuple && tuple->getStorage(attr) == GA_STORE_REAL32 ? attr : nullptr),
+			ints(tuple && tuple->getStorage(attr) == GA_STORE_INT32 ? attr : nullptr),
+			strings(tuple ? nullptr : attr), wide_ints(attr->getStorageClass() == GA_STORECLASS_INT)
+		{
+		}
+		void append(const GA_Offset &off, UT_Array<uint32> &words) const
+		{
+			for (int c = 0; c < tuple_size && tuple; c++) {
+				if (floats.isValid())
+					append_float(words, floats.get(off, c));
+				else if (ints.isValid())
+					words.append(uint32(ints.get(off, c)));
+				else if (wide_ints) {
+					int64 value;
+					tuple->get(attr, off, value, c);
+					append_uint(words, uint64(value));
+				}
+				else {
+					fpreal64 value;
+					tuple->get(attr, off, value, c);
+					if (value == 0.0)
+						value = 0.0;
+					uint64 bits;
+					memcpy(&bits, &value, sizeof(bits));
+					append_uint(words, bits);
+				}
+			}
+			if (strings.isValid())
+				append_string(words, strings.get(off));
+		}
+
+	private:
+		const GA_Attribute *attr;
+		int tuple_size;
+		const GA_AIFTuple *tuple;
+		GA_ROHandleF floats;
+		GA_ROHandleI ints;
+		GA_ROHandleS strings;
+		bool wide_ints;
+	};
+
+	// Values of the elements with indices [start, end)
+	void append_values(const GA_Attribute *attr, const GA_IndexMap &index_map, const exint &start, const exint &end, UT_Array<uint32> &words)
+	{
+		ValueReader reader(attr);
+		for (exint i = start; i < end; i++)
+			reader.append(index_map.offsetFromIndex(GA_Index(i)), words);
+	}
+
+	// Blocks of count elements hashed in parallel, folded in order
+	template <typename BLOCK_WORDS>
+	uint64 hash_blocks(const exint &count, const BLOCK_WORDS &block_words)
+	{
+		exint num_blocks = (count + HASH_BLOCK - 1) / HASH_BLOCK;
+		UT_Array<uint64> block_hashes;
+		block_hashes.setSize(num_blocks);
+		UTparallelFor(UT_BlockedRange<exint>(0, num_blocks), [&](const UT_BlockedRange<exint> &range) {
+			UT_Array<uint32> words;
+			for (exint b = range.begin(); b != range.end(); ++b) {
+				words.clear();
+				block_words(b * HASH_BLOCK, SYSmin(count, (b + 1) * HASH_BLOCK), words);
+				block_hashes(b) = hreeble::hash_words(words.data(), words.entries(), uint64(b));
+			}
+		});
+		return hreeble::hash_words(reinterpret_cast<const uint32*>(block_hashes.data()), block_hashes.entries() * 2, uint64(count));
+	}
+
+	// Values of one attribute in index order
+	uint64 hash_attrib(const GU_Detail *gdp, const GA_Attribute *attr)
+	{
+		const GA_IndexMap &index_map = gdp->getIndexMap(attr->getOwner());
+		return hash_blocks(index_map.indexSize(), [&](const exint &start, const exint &end, UT_Array<uint32> &words) {
+			append_values(attr, index_map, start, end, words);
+		});
+	}
+
+	// Membership of every primitive in group
+	uint64 hash_group(const GU_Detail *gdp, const GA_PrimitiveGroup *group)
+	{
+		return hash_blocks(gdp->getNumPrimitives(), [gdp, group](const exint &start, const exint &end, UT_Array<uint32> &words) {
+			for (exint i = start; i < end; i++)
+				words.append(group->containsOffset(gdp->primitiveOffset(GA_Index(i))) ? 1 : 0);
+		});
+	}
+
+	// Stands for several data ids, invalid when any of them is
+	GA_DataId combine_ids(std::initializer_list<GA_DataId> ids)
+	{
+		hreeble::Hasher hash;
+		for (const auto &id : ids) {
+			if (id == GA_INVALID_DATAID)
+				return GA_INVALID_DATAID;
+			hash.add_uint(uint64(id));
+		}
+		return GA_DataId(hash.value() >> 1);
+	}
+}
+
+
+uint64 hreeble::hash_words(const uint32 *words, const exint &count, const uint64 &seed)
+{
+	// xxHash64 rounds, one independent accumulator per lane
+	const uint64 prime1 = 0x9e3779b185ebca87ULL;
+	const uint64 prime2 = 0xc2b2ae3d27d4eb4fULL;
+	uint64 lanes[4] = { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 };
+	exint i = 0;
+	for (; i + 4 <= count; i += 4) {
+		for (int l = 0; l < 4; l++) {
+			uint64 acc = lanes[l] + uint64(words[i + l]) * prime2;
+			acc = (acc << 31) | (acc >> 33);
+			lanes[l] = acc * prime1;
+		}
+	}
+	Hasher hash;
+	for (int l = 0; l < 4; l++)
+		hash.add_uint(lanes[l]);
+	for (; i < count; i++)
+		hash.add_uint(words[i]);
+	hash.add_uint(uint64(count));
+	return hash.value();
+}
+
+
+uint64 hreeble::hash_geometry(const GU_Detail *gdp)
+{
+	Hasher hash;
+	hash.add_uint(uint64(gdp->getNumPoints()));
+	hash.add_uint(uint64(gdp->getNumPrimitives()));
+	// Point numbers rather than offsets
+	hash.add_uint(hash_blocks(gdp->getNumPrimitives(), [gdp](const exint &start, const exint &end, UT_Array<uint32> &words) {
+		for (exint i = start; i < end; i++) {
+			const GA_Primitive *prim = gdp->getPrimitive(gdp->primitiveOffset(GA_Index(i)));
+			words.append(uint32(prim->getTypeId().get()));
+			words.append(uint32(prim->getVertexCount()));
+			for (GA_Size v = 0; v < prim->getVertexCount(); v++)
+				words.append(uint32(gdp->pointIndex(prim->getPointOffset(v))));
+		}
+	}));
+	for (const auto &owner : HASHED_OWNERS) {
+		for (GA_AttributeDict::iterator it = gdp->getAttributeDict(owner).begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+			hash.add_string(it.attrib()->getName());
+			hash.add_uint(hash_attrib(gdp, it.attrib()));
+		}
+	}
+	// Source groups resolve against these
+	const GA_PrimitiveGroup *group;
+	GA_FOR_ALL_PRIMGROUPS(gdp, group) {
+		if (group->isInternal())
+			continue;
+		hash.add_string(group->getName());
+		hash.add_uint(hash_group(gdp, group));
+	}
+	return hash.value();
+}
+
+
+uint64 hreeble::hash_faces(const GU_Detail *gdp)
+{
+	// By name, dictionary order can differ between details with the same attributes
+	Hasher hash;
+	UT_Array<const GA_Attribute*> attribs[3];
+	const GA_AttributeOwner owners[] = { GA_ATTRIB_POINT, GA_ATTRIB_VERTEX, GA_ATTRIB_PRIMITIVE };
+	for (int o = 0; o < 3; o++) {
+		for (GA_AttributeDict::iterator it = gdp->getAttributeDict(owners[o]).begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it)
+			attribs[o].append(it.attrib());
+		std::sort(attribs[o].begin(), attribs[o].end(), [](const GA_Attribute *a, const GA_Attribute *b) {
+			return strcmp(a->getName(), b->getName()) < 0;
+		});
+		for (const auto &attr : attribs[o])
+			hash.add_string(attr->getName());
+	}
+	// Point values are read through every vertex, shared or not
+	exint num_faces = gdp->getNumPrimitives();
+	UT_Array<uint64> face_hashes;
+	face_hashes.setSize(num_faces);
+	UTparallelFor(UT_BlockedRange<exint>(0, num_faces), [&](const UT_BlockedRange<exint> &range) {
+		std::vector<ValueReader> readers[3];
+		for (int o = 0; o < 3; o++) {
+			for (const auto &attr : attribs[o])
+				readers[o].push_back(ValueReader(attr));
+		}
+		UT_Array<uint32> words;
+		for (exint i = range.begin(); i != range.end(); ++i) {
+			const GA_Primitive *prim = gdp->getPrimitive(gdp->primitiveOffset(GA_Index(i)));
+			words.clear();
+			words.append(uint32(prim->getTypeId().get()));
+			words.append(uint32(prim->getVertexCount()));
+			for (GA_Size v = 0; v < prim->getVertexCount(); v++) {
+				for (const auto &reader : readers[0])
+					reader.append(prim->getPointOffset(v), words);
+				for (const auto &reader : readers[1])
+					reader.append(prim->getVertexOffset(v), words);
+			}
+			for (const auto &reader : readers[2])
+				reader.append(prim->getMapOffset(), words);
+			face_hashes(i) = hash_words(words.data(), words.entries(), 0);
+		}
+	});
+	std::sort(face_hashes.begin(), face_hashes.end());
+	hash.add_uint(hash_words(reinterpret_cast<const uint32*>(face_hashes.data()), face_hashes.entries() * 2, uint64(num_faces)));
+	return hash.value();
+}
+
+
+hreeble::FaceHashes::FaceHashes()
+	:loose_points(0), loose_points_id(GA_INVALID_DATAID), rest(0), rest_id(GA_INVALID_DATAID), detail_hash(0), detail_id(-1)
+{
+	for (int p = 0; p < NUM_PARTS; p++)
+		part_ids[p] = GA_INVALID_DATAID;
+}
+
+
+void hreeble::FaceHashes::update(const GU_Detail *gdp, const UT_Array<const GA_Attribute*> &face_attribs)
+{
+	exint num_faces = gdp->getNumPrimitives();
+	if (exint(gdp->getUniqueId()) != detail_id || hashes.entries() != num_faces) {
+		detail_id = exint(gdp->getUniqueId());
+		for (int p = 0; p < NUM_PARTS; p++) {
+			part_ids[p] = GA_INVALID_DATAID;
+			parts[p].setSize(num_faces);
+		}
+		hashes.setSize(num_faces);
+		loose_points_id = GA_INVALID_DATAID;
+		rest_id = GA_INVALID_DATAID;
+	}
+
+	// What each part reads, the HDK tracks changes per attribute rather than per page.
+	// Names and element counts go in with the ids, renames and resizes keep them.
+	const GA_Attribute *uvattr = gdp->findTextureAttribute(GA_ATTRIB_VERTEX);
+	Hasher attribs_id;
+	attribs_id.add_uint(uint64(gdp->getPrimitiveList().getDataId()));
+	bool attribs_tracked = gdp->getPrimitiveList().getDataId() != GA_INVALID_DATAID;
+	for (const auto attr : face_attribs) {
+		attribs_id.add_string(attr->getName());
+		attribs_id.add_uint(uint64(attr->getDataId()));
+		attribs_tracked &= attr->getDataId() != GA_INVALID_DATAID;
+	}
+	UT_Array<const GA_Attribute*> rest_attribs;
+	Hasher rest_names;
+	rest_names.add_uint(uint64(gdp->getNumPoints()));
+	rest_names.add_uint(uint64(gdp->getNumVertices()));
+	rest_names.add_uint(uint64(num_faces));
+	bool rest_tracked = true;
+	for (const auto &owner : HASHED_OWNERS) {
+		for (GA_AttributeDict::iterator it = gdp->getAttributeDict(owner).begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it) {
+			const GA_Attribute *attr = it.attrib();
+			if (attr == gdp->getP() || attr == uvattr || face_attribs.find(attr) >= 0)
+				continue;
+			rest_attribs.append(attr);
+			rest_names.add_string(attr->getName());
+			rest_names.add_uint(uint64(attr->getDataId()));
+			rest_tracked &= attr->getDataId() != GA_INVALID_DATAID;
+		}
+	}
+	UT_Array<const GA_PrimitiveGroup*> groups;
+	const GA_PrimitiveGroup *group;
+	GA_FOR_ALL_PRIMGROUPS(gdp, group) {
+		if (group->isInternal())
+			continue;
+		groups.append(group);
+		rest_names.add_string(group->getName());
+		rest_names.add_uint(uint64(group->getDataId()));
+		rest_tracked &= group->getDataId() != GA_INVALID_DATAID;
+	}
+	GA_DataId topology_id = combine_ids({ gdp->getPrimitiveList().getDataId(), gdp->getTopology().getPointRef()->getDataId() });
+	GA_DataId ids[NUM_PARTS];
+	ids[TOPOLOGY] = topology_id;
+	ids[POSITIONS] = combine_ids({ topology_id, gdp->getP()->getDataId() });
+	ids[UVS] = uvattr ? combine_ids({ topology_id, uvattr->getDataId() }) : topology_id;
+	ids[PRIM_ATTRIBS] = attribs_tracked ? GA_DataId(attribs_id.value() >> 1) : GA_INVALID_DATAID;
+
+	GA_ROHandleV3 ph(gdp->getP());
+	GA_ROHandleV3 uvh(uvattr);
+	const GA_IndexMap &prim_map = gdp->getIndexMap(GA_ATTRIB_PRIMITIVE);
+	bool changed = false;
+	for (int p = 0; p < NUM_PARTS; p++) {
+		if (ids[p] != GA_INVALID_DATAID && ids[p] == part_ids[p])
+			continue;
+		part_ids[p] = ids[p];
+		changed = true;
+		UTparallelFor(UT_BlockedRange<exint>(0, num_faces, HASH_BLOCK), [&](const UT_BlockedRange<exint> &range) {
+			UT_Array<uint32> words;
+			for (exint i = range.begin(); i != range.end(); ++i) {
+				words.clear();
+				const GA_Primitive *prim = gdp->getPrimitive(gdp->primitiveOffset(GA_Index(i)));
+				GA_Size num_vtx = prim->getVertexCount();
+				if (p == TOPOLOGY) {
+					words.append(uint32(prim->getTypeId().get()));
+					words.append(uint32(num_vtx));
+					for (GA_Size v = 0; v < num_vtx; v++)
+						words.append(uint32(gdp->pointIndex(prim->getPointOffset(v))));
+				}
+				else if (p == POSITIONS || (p == UVS && uvh.isValid())) {
+					for (GA_Size v = 0; v < num_vtx; v++) {
+						UT_Vector3 value = p == POSITIONS ? ph.get(prim->getPointOffset(v)) : uvh.get(prim->getVertexOffset(v));
+						for (int c = 0; c < 3; c++)
+							append_float(words, value(c));
+					}
+				}
+				else if (p == PRIM_ATTRIBS) {
+					for (const auto attr : face_attribs)
+						append_values(attr, prim_map, i, i + 1, words);
+				}
+				parts[p](i) = hash_words(words.data(), words.entries(), uint64(p));
+			}
+		});
+	}
+
+	// Points no face uses only show up in P
+	if (ids[POSITIONS] == GA_INVALID_DATAID || ids[POSITIONS] != loose_points_id) {
+		loose_points_id = ids[POSITIONS];
+		changed = true;
+		UT_Array<uint8> used;
+		used.setSize(gdp->getNumPoints());
+		used.constant(0);
+		for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+			const GA_Primitive *prim = gdp->getPrimitive(*it);
+			for (GA_Size v = 0; v < prim->getVertexCount(); v++)
+				used(gdp->pointIndex(prim->getPointOffset(v))) = 1;
+		}
+		loose_points = hash_blocks(gdp->getNumPoints(), [&](const exint &start, const exint &end, UT_Array<uint32> &words) {
+			for (exint i = start; i < end; i++) {
+				if (used(i))
+					continue;
+				UT_Vector3 value = ph.get(gdp->pointOffset(GA_Index(i)));
+				words.append(uint32(i));
+				for (int c = 0; c < 3; c++)
+					append_float(words, value(c));
+			}
+		});
+	}
+	// Everything else hash_geometry reads, as a whole
+	GA_DataId new_rest_id = rest_tracked ? combine_ids({ topology_id, GA_DataId(rest_names.value() >> 1) }) : GA_INVALID_DATAID;
+	if (new_rest_id == GA_INVALID_DATAID || new_rest_id != rest_id) {
+		rest_id = new_rest_id;
+		changed = true;
+		Hasher hash;
+		for (const auto attr : rest_attribs) {
+			hash.add_string(attr->getName());
+			hash.add_uint(hash_attrib(gdp, attr));
+		}
+		for (const auto member_group : groups) {
+			hash.add_string(member_group->getName());
+			hash.add_uint(hash_group(gdp, member_group));
+		}
+		rest = hash.value();
+	}
+	if (!changed)
+		return;
+	UTparallelFor(UT_BlockedRange<exint>(0, num_faces, HASH_BLOCK), [&](const UT_BlockedRange<exint> &range) {
+		for (exint i = range.begin(); i != range.end(); ++i) {
+			Hasher hash;
+			for (int p = 0; p < NUM_PARTS; p++)
+				hash.add_uint(parts[p](i));
+			hashes(i) = hash.value();
+		}
+	});
+	Hasher hash;
+	hash.add_uint(uint64(gdp->getNumPoints()));
+	hash.add_uint(uint64(num_faces));
+	hash.add_uint(hash_words(reinterpret_cast<const uint32*>(hashes.data()), hashes.entries() * 2, 0));
+	hash.add_uint(loose_points);
+	hash.add_uint(rest);
+	detail_hash = hash.value();
+}
+
+
+uint64 hreeble::FaceHashes::group(const GU_Detail *gdp, const GA_PrimitiveGroup *group) const
+{
+	UT_Array<uint64> members;
+	members.setCapacity(group ? group->entries() : gdp->getNumPrimitives());
+	for (GA_Iterator it(gdp->getPrimitiveRange(group)); !it.atEnd(); ++it)
+		members.append(hashes(gdp->primitiveIndex(*it)));
+	return hash_words(reinterpret_cast<const uint32*>(members.data()), members.entries() * 2, 0);
+}
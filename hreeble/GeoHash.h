@@ -0,0 +1,81 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <GA/GA_Types.h>
+#include <UT/UT_Array.h>
+#include <SYS/SYS_Types.h>
+#include <cstring>
+
+namespace hreeble {
+	// Order dependent 64 bit hash fed whole values, FNV-1a with an extra fold
+	class Hasher
+	{
+	public:
+		Hasher() :state(0xcbf29ce484222325ULL) {}
+		void add_uint(const uint64 &value)
+		{
+			state = (state ^ value) * 0x100000001b3ULL;
+			state ^= state >> 29;
+		}
+		void add_float(const fpreal64 &value)
+		{
+			// -0.0 and 0.0 generate the same geometry
+			fpreal64 v = value == 0.0 ? 0.0 : value;
+			uint64 bits;
+			memcpy(&bits, &v, sizeof(bits));
+			add_uint(bits);
+		}
+		void add_string(const char *str)
+		{
+			for (; str != nullptr && *str != '\0'; str++)
+				add_uint(uint64(uchar(*str)));
+			add_uint(0);
+		}
+		uint64 value() const { return state; }
+
+	private:
+		uint64 state;
+	};
+
+	// Hash of a word array in four independent lanes, so the loop vectorizes
+	uint64 hash_words(const uint32 *words, const exint &count, const uint64 &seed);
+
+	// Content of a detail: point numbered topology, every public attribute and
+	// primitive group. Offsets and fragmentation don't change it. Blocks of
+	// elements are hashed in parallel and folded in order.
+	uint64 hash_geometry(const GU_Detail *gdp);
+
+	// Content of the faces alone: every point, vertex and primitive value a face
+	// reads, folded independent of face order and of which faces share points.
+	// Tiled runs match single ones under it.
+	uint64 hash_faces(const GU_Detail *gdp);
+
+	// Per primitive hashes of P, topology, vertex uvs and the primitive
+	// attributes generation reads from a face, kept between updates. Points no
+	// face uses and everything else hash_geometry reads are hashed as a whole.
+	// Each part only gets rehashed when the data ids it reads changed.
+	class FaceHashes
+	{
+	public:
+		FaceHashes();
+		// face_attribs are the primitive attributes hashed per face
+		void update(const GU_Detail *gdp, const UT_Array<const GA_Attribute*> &face_attribs);
+		// By primitive index
+		uint64 face(const exint &index) const { return hashes(index); }
+		// In order fold over the faces of group, all of them when null
+		uint64 group(const GU_Detail *gdp, const GA_PrimitiveGroup *group) const;
+		// Content of the whole detail, as complete as hash_geometry
+		uint64 detail() const { return detail_hash; }
+
+	private:
+		enum Parts { TOPOLOGY, POSITIONS, UVS, PRIM_ATTRIBS, NUM_PARTS };
+		UT_Array<uint64> parts[NUM_PARTS];
+		GA_DataId part_ids[NUM_PARTS];
+		UT_Array<uint64> hashes;
+		uint64 loose_points;
+		GA_DataId loose_points_id;
+		uint64 rest;
+		GA_DataId rest_id;
+		uint64 detail_hash;
+		exint detail_id;
+	};
+}
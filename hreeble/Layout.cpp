@@ -0,0 +1,140 @@
+#include "Layout.h"
+#include <algorithm>
+#include <cmath>
+
+namespace hreeble {
+	OutlineBounds outline_bounds(const float *xs, const float *ys, const int64_t num)
+	{
+		OutlineBounds bounds = { { xs[0], ys[0] }, { xs[0], ys[0] } };
+		for (int64_t i = 1; i < num; i++) {
+			bounds.min[0] = std::min(bounds.min[0], xs[i]);
+			bounds.max[0] = std::max(bounds.max[0], xs[i]);
+			bounds.min[1] = std::min(bounds.min[1], ys[i]);
+			bounds.max[1] = std::max(bounds.max[1], ys[i]);
+		}
+		return bounds;
+	}
+
+
+	void outline_pivot(const float *xs, const float *ys, const int64_t num, double *pivot)
+	{
+		double sum_x = 0.0, sum_y = 0.0;
+		for (int64_t i = 0; i < num; i++) {
+			sum_x += xs[i];
+			sum_y += ys[i];
+		}
+		pivot[0] = sum_x / num;
+		pivot[1] = sum_y / num;
+	}
+
+
+	void bounds_offset(const float *xs, const float *ys, const int64_t num, double *offset)
+	{
+		auto outside = [](const double val) { return val > 1.0 || val < 0.0; };
+		auto sign = [](const double val) { return val > 0 ? 1.0 : 0.0; };
+		OutlineBounds bounds = outline_bounds(xs, ys, num);
+		for (int axis = 0; axis < 2; axis++) {
+			offset[axis] = 0.0;
+			if (outside(bounds.min[axis]))
+				offset[axis] += sign(bounds.min[axis]) - bounds.min[axis];
+			if (outside(bounds.max[axis]))
+				offset[axis] += sign(bounds.max[axis]) - bounds.max[axis];
+		}
+	}
+
+
+	static void move_outline(float *xs, float *ys, const int64_t num, const double *vec)
+	{
+		float vx = float(vec[0]), vy = float(vec[1]);
+		for (int64_t i = 0; i < num; i++) {
+			xs[i] += vx;
+			ys[i] += vy;
+		}
+	}
+
+
+	void place_outline(float *xs, float *ys, const int64_t num, const double *target, const double scale, OutlineXform &xform)
+	{
+		// Move
+		double pivot[2];
+		outline_pivot(xs, ys, num, pivot);
+		double vec[2] = { target[0] - pivot[0], target[1] - pivot[1] };
+		move_outline(xs, ys, num, vec);
+		// Scale
+		outline_pivot(xs, ys, num, pivot);
+		float px = float(pivot[0]), py = float(pivot[1]), s = float(scale - 1);
+		for (int64_t i = 0; i < num; i++) {
+			xs[i] += (xs[i] - px) * s;
+			ys[i] += (ys[i] - py) * s;
+		}
+		for (int axis = 0; axis < 2; axis++) {
+			xform.origin[axis] += vec[axis];
+			xform.origin[axis] += (xform.origin[axis] - pivot[axis]) * (scale - 1);
+			xform.scale[axis] *= scale;
+		}
+		// Place
+		double offset[2];
+		bounds_offset(xs, ys, num, offset);
+		if (offset[0] != 0.0 || offset[1] != 0.0) {
+			offset[0] *= 1.2;
+			offset[1] *= 1.2;
+			move_outline(xs, ys, num, offset);
+			xform.origin[0] += offset[0];
+			xform.origin[1] += offset[1];
+		}
+		// Still outside: fit the bounds into the face per axis. Affine, so the
+		// instance transform describes the same outline as the built polygons.
+		bounds_offset(xs, ys, num, offset);
+		if (offset[0] == 0.0 && offset[1] == 0.0)
+			return;
+		OutlineBounds bounds = outline_bounds(xs, ys, num);
+		for (int axis = 0; axis < 2; axis++) {
+			float *values = axis == 0 ? xs : ys;
+			float lo = bounds.min[axis], hi = bounds.max[axis];
+			float fit_lo = std::max(std::min(lo, 0.99f), 0.01f);
+			float fit_hi = std::max(std::min(hi, 0.99f), 0.01f);
+			float k = hi > lo ? (fit_hi - fit_lo) / (hi - lo) : 1.0f;
+			for (int64_t i = 0; i < num; i++)
+				values[i] = fit_lo + (values[i] - lo) * k;
+			xform.origin[axis] = fit_lo + (xform.origin[axis] - lo) * k;
+			xform.scale[axis] *= k;
+		}
+	}
+
+
+	bool quad_split_points(const float *corners, const int64_t num_vtx, const int dir, float *first, float *second)
+	{
+		if (num_vtx != 4)
+			return false;
+		// Start and end corner of the cut edges
+		const int edges[2][4] = { { 1, 2, 0, 3 }, { 0, 1, 3, 2 } };
+		const int *edge = edges[dir == 0 ? 0 : 1];
+		for (int c = 0; c < 3; c++) {
+			first[c] = corners[edge[0] * 3 + c] + (corners[edge[1] * 3 + c] - corners[edge[0] * 3 + c]) * 0.5f;
+			second[c] = corners[edge[2] * 3 + c] + (corners[edge[3] * 3 + c] - corners[edge[2] * 3 + c]) * 0.5f;
+		}
+		return true;
+	}
+
+
+	double inset_ring(const float *base, const int64_t num, const float *n, const float *center, const double height,
+					  const double inset, const double max_size, float *top, float *dirs)
+	{
+		double size = max_size;
+		for (int64_t i = 0; i < num; i++) {
+			float *t = top + i * 3, *d = dirs + i * 3;
+			for (int c = 0; c < 3; c++) {
+				t[c] = base[i * 3 + c] + n[c] * float(height);
+				d[c] = center[c] - t[c];
+			}
+			float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+			size = std::min(size, std::max(length - inset, 0.0) * 0.5);
+			for (int c = 0; c < 3; c++) {
+				if (length > 0.0f)
+					d[c] /= length;
+				t[c] += d[c] * float(inset);
+			}
+		}
+		return size;
+	}
+}
@@ -0,0 +1,118 @@
+#include "MeshFile.h"
+#include <GA/GA_Handle.h>
+#include <GEO/GEO_Primitive.h>
+#include <UT/UT_Array.h>
+#include <cstdio>
+#include <cstring>
+
+static const char MESH_MAGIC[8] = { 'H', 'R', 'M', 'E', 'S', 'H', '\0', '\0' };
+static const uint32 MESH_VERSION = 1;
+
+namespace {
+	// Vertex or point attribute, read through the vertex either way
+	struct VertexAttrib
+	{
+		GA_ROHandleV3 handle;
+		bool per_point;
+
+		void bind(const GA_Attribute *vertex_attr, const GA_Attribute *point_attr)
+		{
+			handle.bind(vertex_attr ? vertex_attr : point_attr);
+			per_point = !vertex_attr;
+		}
+
+		UT_Vector3 get(const GA_Detail *gdp, const GA_Offset &vtx) const
+		{
+			return handle.get(per_point ? gdp->vertexPoint(vtx) : vtx);
+		}
+	};
+}
+
+
+bool hreeble::write_mesh(const GU_Detail *gdp, const char *path, UT_String &error)
+{
+	VertexAttrib normals, uvs;
+	normals.bind(gdp->findNormalAttribute(GA_ATTRIB_VERTEX), gdp->findNormalAttribute(GA_ATTRIB_POINT));
+	uvs.bind(gdp->findTextureAttribute(GA_ATTRIB_VERTEX), gdp->findTextureAttribute(GA_ATTRIB_POINT));
+	bool has_normals = normals.handle.isValid();
+	bool has_uvs = uvs.handle.isValid();
+
+	// Welded vertices chain per point, so a lookup only compares the few splits of one point
+	UT_Array<exint> point_first, next_split;
+	point_first.setSize(gdp->getNumPointOffsets());
+	point_first.constant(-1);
+	UT_Array<GA_Offset> welded_points;
+	UT_Array<fpreal32> positions, normal_data, uv_data;
+	UT_Array<uint32> indices;
+	auto weld = [&](const GA_Offset &vtx) {
+		GA_Offset ptof = gdp->vertexPoint(vtx);
+		UT_Vector3 N = has_normals ? normals.get(gdp, vtx) : UT_Vector3(0, 0, 0);
+		UT_Vector3 uv = has_uvs ? uvs.get(gdp, vtx) : UT_Vector3(0, 0, 0);
+		for (exint i = point_first(ptof); i >= 0; i = next_split(i)) {
+			bool same = true;
+			if (has_normals)
+				same = normal_data(3 * i) == N.x() && normal_data(3 * i + 1) == N.y() && normal_data(3 * i + 2) == N.z();
+			if (same && has_uvs)
+				same = uv_data(2 * i) == uv.x() && uv_data(2 * i + 1) == uv.y();
+			if (same)
+				return uint32(i);
+		}
+		exint index = welded_points.append(ptof);
+		next_split.append(point_first(ptof));
+		point_first(ptof) = index;
+		UT_Vector3 P = gdp->getPos3(ptof);
+		positions.append(P.x());
+		positions.append(P.y());
+		positions.append(P.z());
+		if (has_normals) {
+			normal_data.append(N.x());
+			normal_data.append(N.y());
+			normal_data.append(N.z());
+		}
+		if (has_uvs) {
+			uv_data.append(uv.x());
+			uv_data.append(uv.y());
+		}
+		return uint32(index);
+	};
+
+	for (GA_Iterator it(gdp->getPrimitiveRange()); !it.atEnd(); ++it) {
+		const GEO_Primitive *prim = gdp->getGEOPrimitive(*it);
+		if (prim->getTypeId() != GA_PRIMPOLY || prim->getVertexCount() < 3)
+			continue;
+		// Houdini faces wind clockwise, engines expect the opposite
+		uint32 first = weld(prim->getVertexOffset(0));
+		uint32 prev = weld(prim->getVertexOffset(1));
+		for (GA_Size i = 2; i < prim->getVertexCount(); i++) {
+			uint32 next = weld(prim->getVertexOffset(i));
+			indices.append(first);
+			indices.append(next);
+			indices.append(prev);
+			prev = next;
+		}
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		error.sprintf("Could not open mesh file %s", path);
+		return false;
+	}
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC));
+	header.version = MESH_VERSION;
+	header.flags = (has_normals ? MESH_HAS_NORMALS : 0) | (has_uvs ? MESH_HAS_UVS : 0);
+	header.num_vertices = uint32(welded_points.entries());
+	header.num_indices = uint32(indices.entries());
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(positions.data(), sizeof(fpreal32), positions.entries(), file) == size_t(positions.entries())
+		&& fwrite(normal_data.data(), sizeof(fpreal32), normal_data.entries(), file) == size_t(normal_data.entries())
+		&& fwrite(uv_data.data(), sizeof(fpreal32), uv_data.entries(), file) == size_t(uv_data.entries())
+		&& fwrite(indices.data(), sizeof(uint32), indices.entries(), file) == size_t(indices.entries());
+	fclose(file);
+	if (!ok) {
+		remove(path);
+		error.sprintf("Could not write mesh file %s", path);
+	}
+	return ok;
+}
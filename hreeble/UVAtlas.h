@@ -0,0 +1,34 @@
+#pragma once
+#include <GA/GA_Handle.h>
+#include <GA/GA_Types.h>
+#include <UT/UT_Array.h>
+#include <UT/UT_IntArray.h>
+#include <SYS/SYS_Types.h>
+
+// Collects element charts during generation and packs them into a single uv
+// tile with a shelf packer. Chart coordinates are in world units, so one scale
+// for the whole atlas keeps texel density uniform.
+class UVAtlas
+{
+public:
+	UVAtlas();
+	void clear();
+	int new_chart() { return num_charts++; }
+	void add(const int &chart, const GA_Offset &vertex, const fpreal32 &u, const fpreal32 &v);
+	exint entries() const { return vertices.entries(); }
+	// padding is the gap between charts, narrower when there are too many charts for it.
+	// False leaves the uvs as they were.
+	bool pack(const GA_RWHandleV3D &uvh, const int &tile, const fpreal &padding);
+
+private:
+	bool place(const UT_IntArray &order, const fpreal &scale, const fpreal &padding);
+
+	int num_charts;
+	UT_IntArray charts;
+	UT_Array<GA_Offset> vertices;
+	UT_Array<fpreal32> us;
+	UT_Array<fpreal32> vs;
+	// Per chart bounds and packed position
+	UT_Array<fpreal32> min_u, min_v, max_u, max_v;
+	UT_Array<fpreal> pos_u, pos_v;
+};
@@ -0,0 +1,69 @@
+#include "UVFrame.h"
+#include <SYS/SYS_Math.h>
+
+UVFrame::UVFrame()
+	:host(nullptr), island_center(0.0, 0.0, 0.0), area_ratio(0.0)
+{
+}
+
+
+bool UVFrame::init(const GEO_Primitive *prim, const GA_Attribute *uvattr)
+{
+	GA_ROHandleV3D uvh(uvattr);
+	host = prim;
+	vertices.clear();
+	uvs.clear();
+	island_center.assign(0.0);
+	area_ratio = 0.0;
+	GA_Size num_vtx = prim->getVertexCount();
+	if (!uvh.isValid() || num_vtx < 3)
+		return false;
+	for (GA_Size i = 0; i < num_vtx; i++) {
+		GA_Offset vtx = prim->getVertexOffset(i);
+		vertices.append(vtx);
+		uvs.append(UT_Vector3R(uvh.get(vtx)));
+		island_center += uvs(i);
+	}
+	island_center /= num_vtx;
+	island_center.z() = 0.0;
+	fpreal uv_area = 0.0;
+	for (GA_Size i = 0; i < num_vtx; i++) {
+		const UT_Vector3R &a = uvs(i);
+		const UT_Vector3R &b = uvs((i + 1) % num_vtx);
+		uv_area += a.x() * b.y() - b.x() * a.y();
+	}
+	fpreal prim_area = prim->calcArea();
+	if (prim_area > 0.0)
+		area_ratio = SYSabs(uv_area) * 0.5 / prim_area;
+	return true;
+}
+
+
+UT_Vector3R UVFrame::uv_at(const fpreal &u, const fpreal &v) const
+{
+	weight_vertices.clear();
+	weights.clear();
+	host->computeInteriorPointWeights(weight_vertices, weights, u, v, 0.0);
+	UT_Vector3R uv(0.0, 0.0, 0.0);
+	for (exint i = 0; i < weight_vertices.entries(); i++) {
+		exint index = vertices.find(weight_vertices(i));
+		if (index >= 0)
+			uv += uvs(index) * weights(i);
+	}
+	return uv;
+}
+
+
+UT_Vector3R UVFrame::wall_offset(const UT_Vector3R &uv0, const UT_Vector3R &uv1, const fpreal &wall_area) const
+{
+	UT_Vector3R vv = uv1 - uv0;
+	fpreal uv_edge_len = vv.length();
+	if (uv_edge_len <= 0.0)
+		return UT_Vector3R(0.0, 0.0, 0.0);
+	fpreal offset_val = wall_area * area_ratio / uv_edge_len;
+	vv /= uv_edge_len;
+	UT_Vector3R projpoint = uv0 + vv * (island_center - uv0).dot(vv);
+	UT_Vector3R offset_dir = projpoint - island_center;
+	offset_dir.normalize();
+	return offset_dir * offset_val;
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <SYS/SYS_Math.h>
+#include <GEO/GEO_Primitive.h>
+#include <GA/GA_Handle.h>
 
 namespace hreeble {
 	template <template <class> class T, class S> inline
@@ -8,10 +10,32 @@ namespace hreeble {
 		return collection(index);
 	}
 
+	// Seed of one source face, independent of the order faces are processed in
+	inline
+	uint face_seed(const uint &seed, const exint &face_id) {
+		uint64 id = uint64(face_id);
+		return SYSwang_inthash(seed ^ SYSwang_inthash(uint(id) ^ SYSwang_inthash(uint(id >> 32))));
+	}
+
 	inline
 	bool rand_bool(const uint &seed) {
 		uint seed_ = seed;
 		return SYSfastRandom(seed_) > 0.5 ? true : false;
 	}
+
+	// Flat face normal and a tangent orthogonal to it on every vertex of a new prim
+	inline
+	void set_vertex_frame(const GA_RWHandleV3 &nh, const GA_RWHandleV3 &th, const GEO_Primitive *prim,
+						  const UT_Vector3 &fallbackN, const UT_Vector3 &tangent) {
+		UT_Vector3 N = prim->computeNormal();
+		if (N.length2() == 0.0f)
+			N = fallbackN;
+		UT_Vector3 T = tangent - N * tangent.dot(N);
+		T.normalize();
+		for (GA_Size i = 0; i < prim->getVertexCount(); i++) {
+			nh.set(prim->getVertexOffset(i), N);
+			th.set(prim->getVertexOffset(i), T);
+		}
+	}
 }
 
@@ -5,7 +5,11 @@
 #include <PRM/PRM_Include.h>
 #include <GEO/GEO_PrimPoly.h>
 #include <UT/UT_ValArray.h>
-
+#include <GU/GU_DetailHandle.h>
+#include "Generator.h"
+#include "BackgroundCook.h"
+#include "DiskCache.h"
+#include "GeoHash.h"
 
 class SOP_Hreeble : public SOP_Node
 {
@@ -14,14 +18,8 @@ public:
 	~SOP_Hreeble();
 	static OP_Node *creator(OP_Network*, const char*, OP_Operator*);
 	virtual OP_ERROR cookInputGroups(OP_Context &ctx, int alone = 0);
-	void split_primitive(GEO_Primitive *prim, UT_ValArray<GEO_Primitive*> &result, const unsigned short dir = 0);
-	void divide(GEO_Primitive *prim, UT_ValArray<GEO_Primitive*> &result);
-	GEO_Primitive* extrude(GEO_Primitive *prim, const fpreal &height, const fpreal &inset);
 	static PRM_Template myparms[];
 
-	GA_PrimitiveGroup *top_prims_grp;
-	GA_PrimitiveGroup *work_group;
-
 protected:
 	virtual OP_ERROR cookMySop(OP_Context &ctx);
 	bool updateParmsFlags();
@@ -40,15 +38,35 @@ private:
 	uint CreateGroupsPRM() { return evalInt("elem_groups", 0, 0); }
 	uint UnwrapUVsPRM() { return evalInt("unwrap_uvs", 0, 0); }
 	uint InheritAttribsPRM() { return evalInt("inherit_attribs", 0, 0); }
+	uint ChunkedCookPRM() { return evalInt("chunked_cook", 0, 0); }
+	exint ChunkSizePRM() { return evalInt("chunk_size", 0, 0); }
+	fpreal64 MemoryBudgetPRM() { return evalFloat("memory_budget", 0, 0.0); }
+	LODModes LODModePRM() { return static_cast<LODModes>(evalInt("lod_mode", 0, 0)); }
+	void LODCameraPRM(fpreal64 vals[], const fpreal &time) { evalFloats("lod_camera", vals, time); }
+	fpreal64 LODCapSizePRM() { return evalFloat("lod_cap_size", 0, 0.0); }
+	fpreal64 LODCullSizePRM() { return evalFloat("lod_cull_size", 0, 0.0); }
+	void ShapeLibraryPRM(UT_String &str, const fpreal &time) { evalString(str, "shape_library", 0, time); }
+	void LibraryShapesPRM(UT_String &str, const fpreal &time) { evalString(str, "library_shapes", 0, time); }
+	uint CapTrianglesPRM() { return evalInt("cap_triangles", 0, 0); }
+	fpreal64 ElemBevelPRM() { return evalFloat("elem_bevel", 0, 0.0); }
+	fpreal64 PanelBevelPRM() { return evalFloat("panel_bevel", 0, 0.0); }
+	BevelShapes BevelShapePRM() { return static_cast<BevelShapes>(evalInt("bevel_shape", 0, 0)); }
+	int BevelSegmentsPRM() { return evalInt("bevel_segments", 0, 0); }
+	uint ElemTiersPRM() { return (uint)evalInt("elem_tiers", 0, 0); }
+	fpreal64 TierFalloffPRM() { return evalFloat("tier_falloff", 0, 0.0); }
+	uint PackUVsPRM() { return evalInt("pack_uvs", 0, 0); }
+	int UVTilePRM() { return evalInt("uv_tile", 0, 0); }
+	uint OutputNormalsPRM() { return evalInt("output_normals", 0, 0); }
+	WatertightModes WatertightPRM() { return static_cast<WatertightModes>(evalInt("watertight", 0, 0)); }
+	void MeshFilePRM(UT_String &str, const fpreal &time) { evalString(str, "mesh_file", 0, time); }
+	uint AsyncCookPRM() { return evalInt("async_cook", 0, 0); }
+	fpreal64 PreviewFacesPRM() { return evalFloat("preview_faces", 0, 0.0); }
+	void CacheDirPRM(UT_String &str, const fpreal &time) { evalString(str, "cache_dir", 0, time); }
+	OutputModes OutputModePRM() { return static_cast<OutputModes>(evalInt("output_mode", 0, 0)); }
 
-	GA_RWHandleV3 phandle; // point handle
-	GA_Attribute *uvattr; // vertext handle
-	GA_AttributeRefMap prim_refmap;
-	UT_ValArray<GEO_Primitive*> kill_prims;
 	const GA_PrimitiveGroup *source_prim_group;
-	GA_PrimitiveGroup *elements_group;
-	GA_PrimitiveGroup *elements_front_group;
-	uint inherit_attribs;
-	uint unwrap_uvs;
-	uint my_seed;
-};
\ No newline at end of file
+	Generator generator;
+	BackgroundCook background;
+	DiskCache disk_cache;
+	hreeble::FaceHashes input_hashes;
+};
\ No newline at end of file
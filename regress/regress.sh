@@ -0,0 +1,102 @@
+#!/bin/sh
+# Runs hreeble_cli over a fixed matrix of synthetic inputs and parameters and
+# compares every output checksum with regress/goldens.txt, printing the
+# throughput of each case. Cases whose golden is still "-" are run but not
+# compared, --strict fails on them. --update rewrites the goldens from this run.
+# Every case is also run with --tiles 3 and its faces compared with --tiles 1
+# through --face_checksum.
+#
+# usage: regress/regress.sh [--update | --strict] [path to hreeble_cli]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+GOLDENS="$DIR/goldens.txt"
+UPDATE=0
+STRICT=0
+case "$1" in
+	--update) UPDATE=1; shift ;;
+	--strict) STRICT=1; shift ;;
+esac
+CLI=${1:-./hreeble_cli}
+SIZE=16
+TILES=3
+
+KINDS="quads tris ngons mixed"
+PANELS="0 1"
+SHAPE_BITS="0 1 2 3 4 5"
+UNWRAP="0 1"
+INHERIT="0 1"
+SEEDS="1 7 42"
+
+if [ ! -x "$CLI" ]; then
+	echo "regress: no hreeble_cli at $CLI, build it with make cli" >&2
+	exit 2
+fi
+
+OUT=$(mktemp)
+WORK=$(mktemp -d)
+trap 'rm -rf "$OUT" "$WORK"' EXIT
+echo "# case checksum, regenerate with regress/regress.sh --update" > "$OUT"
+
+failed=0
+skipped=0
+total=0
+for kind in $KINDS; do
+for panels in $PANELS; do
+for bit in $SHAPE_BITS; do
+for unwrap in $UNWRAP; do
+for inherit in $INHERIT; do
+for seed in $SEEDS; do
+	name="${kind}_p${panels}_s${bit}_u${unwrap}_i${inherit}_seed${seed}"
+	total=$((total + 1))
+	parms="--seed $seed --gen_panels $panels --elem_shapes $((1 << bit)) --unwrap_uvs $unwrap --inherit_attribs $inherit"
+	line=$("$CLI" --checksum $parms "synthetic:$kind:$SIZE" - 2>/dev/null)
+	if [ $? -ne 0 ] || [ -z "$line" ]; then
+		echo "$name FAILED"
+		failed=$((failed + 1))
+		continue
+	fi
+	hash=${line%% *}
+	echo "$name $hash" >> "$OUT"
+	expected=$(awk -v n="$name" '$1 == n { print $2 }' "$GOLDENS" 2>/dev/null)
+	if [ $UPDATE -eq 1 ] || [ "$hash" = "$expected" ]; then
+		status=ok
+	elif [ -z "$expected" ] || [ "$expected" = "-" ]; then
+		status="skipped, no golden"
+		skipped=$((skipped + 1))
+	else
+		status="MISMATCH, expected $expected"
+		failed=$((failed + 1))
+	fi
+	# Same faces however many tiles, up to their order and border points
+	single=$("$CLI" --face_checksum --tiles 1 $parms "synthetic:$kind:$SIZE" "$WORK/single.hmesh" 2>/dev/null)
+	tiled=$("$CLI" --face_checksum --tiles $TILES $parms "synthetic:$kind:$SIZE" "$WORK/tiled.hmesh" 2>/dev/null)
+	if [ -z "$single" ] || [ "${single%% *}" != "${tiled%% *}" ]; then
+		status="$status, TILES DIFFER"
+		[ $UPDATE -eq 1 ] || failed=$((failed + 1))
+	fi
+	echo "$name ${line#* } $status"
+done
+done
+done
+done
+done
+done
+
+if [ $UPDATE -eq 1 ]; then
+	if [ $failed -ne 0 ]; then
+		echo "regress: $failed of $total cases failed to run, goldens left untouched" >&2
+		exit 1
+	fi
+	cp "$OUT" "$GOLDENS"
+	echo "regress: wrote $total goldens to $GOLDENS"
+	exit 0
+fi
+if [ $skipped -ne 0 ]; then
+	echo "regress: $skipped of $total cases have no golden yet, run regress/regress.sh --update on a trusted build" >&2
+	[ $STRICT -eq 1 ] && failed=$((failed + skipped))
+fi
+if [ $failed -ne 0 ]; then
+	echo "regress: $failed of $total cases failed" >&2
+	exit 1
+fi
+echo "regress: $((total - skipped)) of $total cases match"
@@ -0,0 +1,79 @@
+#include "DiskCache.h"
+#include "BinaryMesh.h"
+#include "GeoHash.h"
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+	// Temp names unique across processes sharing a cache directory, also on
+	// other hosts where pids repeat, and across stores within one process
+	void temp_name(const char *file_path, UT_String &result)
+	{
+		static const uint64 process_token = (uint64(std::random_device()()) << 32) ^ std::random_device()();
+		static std::atomic<uint64> counter(0);
+		result.sprintf("%s.%d.%016llx.%llu.tmp", file_path, int(getpid()), (unsigned long long)process_token,
+					   (unsigned long long)counter++);
+	}
+}
+
+uint64 DiskCache::key(const uint64 &input_hash, const char *source_groups, const GeneratorParms &parms)
+{
+	hreeble::Hasher h;
+	h.add_uint(GENERATOR_VERSION);
+	h.add_uint(input_hash);
+	h.add_uint(parms.hash());
+	h.add_string(source_groups);
+	// An edited library keeps its path
+	struct stat library_stat;
+	if (!parms.shape_library.empty() && stat(parms.shape_library.c_str(), &library_stat) == 0) {
+		h.add_uint(uint64(library_stat.st_mtime));
+		h.add_uint(uint64(library_stat.st_size));
+	}
+	return h.value();
+}
+
+
+void DiskCache::path(const char *dir, const uint64 &key, UT_String &result)
+{
+	result.sprintf("%s/hreeble_%016llx.hmesh", dir, (unsigned long long)key);
+}
+
+
+bool DiskCache::load(const char *dir, const uint64 &key, GU_Detail *gdp)
+{
+	UT_String file_path, error;
+	path(dir, key, file_path);
+	FILE *file = fopen(file_path, "rb");
+	if (!file)
+		return false;
+	fclose(file);
+	GU_Detail cached;
+	if (!hreeble::load_hmesh(file_path, &cached, error))
+		return false;
+	gdp->duplicate(cached);
+	return true;
+}
+
+
+bool DiskCache::store(const char *dir, const uint64 &key, const GU_Detail *gdp, UT_String &error)
+{
+	if (!hreeble::hmesh_lossless(gdp))
+		return true;
+	// Written aside and renamed, so concurrent cooks never read half a file
+	UT_String file_path, temp_path;
+	path(dir, key, file_path);
+	temp_name(file_path, temp_path);
+	if (!hreeble::save_hmesh(gdp, temp_path, error))
+		return false;
+	if (rename(temp_path, file_path) != 0)
+		remove(temp_path);
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <UT/UT_String.h>
+#include <SYS/SYS_Types.h>
+#include "Generator.h"
+
+// Generated results kept as .hmesh files in a directory, named after a hash of
+// the input geometry, the parameters and the generator version. Outputs the
+// format can't hold exactly are never stored, so every hit is exact.
+class DiskCache
+{
+public:
+	// input_hash is the content of the input geometry, FaceHashes::detail()
+	uint64 key(const uint64 &input_hash, const char *source_groups, const GeneratorParms &parms);
+	bool load(const char *dir, const uint64 &key, GU_Detail *gdp);
+	// False only when a storable result could not be written
+	bool store(const char *dir, const uint64 &key, const GU_Detail *gdp, UT_String &error);
+
+private:
+	void path(const char *dir, const uint64 &key, UT_String &result);
+};
@@ -1,393 +1,671 @@
-#include "Element.h"
-#include <GEO/GEO_PrimPoly.h>
-#include <UT/UT_Pair.h>
-#include <SYS/SYS_Math.h>
-#include <GA/GA_AttributeRefMap.h>
-#include <GA/GA_ElementWrangler.h>
-
-typedef UT_Vector2R V2R;
-typedef UT_Pair<GA_Offset, GA_Offset> OffsetPair;
-
-Element::Element(ElementTypes type, const short &direction, GA_Attribute *uvattr, GA_PrimitiveGroup *elem_grp, GA_PrimitiveGroup *elem_front_grp)
-	:type(type), direction(direction), elem_group(elem_grp), elem_front_group(elem_front_grp), uvattr(uvattr)
-{
-}
-
-
-Element::~Element()
-{
-}
-
-
-BBox2D Element::bbox()
-{
-	fpreal min_s = subelements(0).coords(0).x();
-	fpreal max_s = 0.0;
-	fpreal min_t = subelements(0).coords(0).y();
-	fpreal max_t = 0.0;
-
-	for (const auto &subelem : subelements) {
-		for (const auto &pt : subelem.coords) {
-			if (pt.x() > max_s)
-				max_s = pt.x();
-			else if (pt.x() < min_s)
-				min_s = pt.x();
-
-			if (pt.y() > max_t)
-				max_t = pt.y();
-			else if (pt.y() < min_t)
-				min_t = pt.y();
-	}
-	}
-	BBox2D bbox = { UT_Vector2R(min_s, min_t), UT_Vector2R(max_s, max_t) };
-	return bbox;
-}
-
-
-UT_Vector2R Element::pivot()
-{
-	UT_Vector2R pivot(0.0, 0.0);
-	for (const auto &elem: subelements) {
-		for (const auto &pt : elem.coords) {
-			pivot += pt;
-		}
-	}
-	pivot /= num_points();
-	return pivot;
-}
-
-
-UT_Vector2R Element::bounds_intersection()
-{
-	auto sign = [](const fpreal val) { return val > 0 ? 1 : 0; };
-	auto outside = [](fpreal val) { return val > 1.0 || val < 0.0; };
-
-	V2R offset(0.0, 0.0);
-	BBox2D bbox = this->bbox();
-	if (outside(bbox.minvec.x())) {
-		offset += V2R(sign(bbox.minvec.x()) - bbox.minvec.x(), 0.0);
-	}
-	if (outside(bbox.minvec.y())) {
-		offset += V2R(0.0, sign(bbox.minvec.y()) - bbox.minvec.y());
-	}
-
-	if (outside(bbox.maxvec.x())) {
-		offset += V2R(sign(bbox.maxvec.x()) - bbox.maxvec.x(), 0.0);
-	}
-	if (outside(bbox.maxvec.y())) {
-		offset += V2R(0.0, sign(bbox.maxvec.y()) - bbox.maxvec.y());
-
-	}
-	return offset;
-}
-
-
-void Element::append(SubElem elem)
-{
-	subelements.append(elem);
-}
-
-
-void Element::move_by_vec(const UT_Vector2R & vec)
-{
-	for (auto &subelem : subelements) {
-		for (auto &pt : subelem.coords) {
-			pt += vec;
-		}
-	}
-}
-
-
-void Element::transform(const UT_Vector2R & new_pos, const fpreal & scale, const bool flip)
-{
-	// Flip
-	if (flip) {
-		if (type == ElementTypes::TSHAPE || type == ElementTypes::RSHAPE) {
-			for (auto &subelem : subelements) {
-				subelem.coords.reverse();
-				for (auto &pt : subelem.coords) {
-					pt(direction) = 1 - pt(direction);
-				}
-			}
-		}
-	}
-	// Move
-	UT_Vector2R vec;
-	if (type == ElementTypes::TRIANGLE) {
-		UT_Vector2R pp;
-		pp(0) = SYSfit01(new_pos(0), 0.0, 1 - new_pos(1));
-		pp(1) = SYSfit01(new_pos(1), 0.0, 1 - new_pos(0));
-		vec = pp - this->pivot();
-	}
-	else
-		vec = new_pos - this->pivot();
-	move_by_vec(vec);
-	UT_Vector2R pivot = this->pivot();
-	// Scale
-	for (auto &subelem : subelements) {
-		for (auto &pt : subelem.coords) {
-			pt += (pt - pivot) * (scale - 1);
-		}
-	}
-	// Place
-	V2R offset = bounds_intersection();
-	if (offset.length() != 0) {
-		offset *= 1.2;
-		move_by_vec(offset);
-	}
-	//if (bounds_intersection().length() != 0) {
-	//	for (auto &subelem : subelements) {
-	//		for (int i = 0; i < subelem.coords.entries(); i++) {
-	//			auto coord = subelem.coords(i);
-	//			if (SYSalmostEqual(coord.x(), 1.0)) {
-	//				
-	//			}
-	//		}
-	//	}
-	//}
-	if (bounds_intersection().length() != 0) {
-		for (auto &subelem : subelements) {
-			for (auto &pt : subelem.coords) {
-				pt(0) = SYSmax(SYSmin(pt.x(), 0.99), 0.01);
-				pt(1) = SYSmax(SYSmin(pt.y(), 0.99), 0.01);
-			}
-		}
-	}
-}
-
-
-
-void Element::build(GU_Detail *gdp, const GEO_Primitive *prim, const UT_Vector3F &primN, const fpreal & height)
-{
-	GA_RWHandleV3 ph(gdp->getP());
-	GA_AttributeRefMap vertex_refmap(*gdp);
-	GA_RWHandleV3D vh;
-	UT_Vector3R island_center;
-	UT_Array<GEO_PrimPoly*> result_prims;
-	fpreal uv_area, source_prim_area;
-	if (this->unwrapuvs) {
-		vh = uvattr;
-		vertex_refmap.appendDest(vh.getAttribute());
-		island_center.assign(0.0);
-		for (GA_Iterator it(prim->getVertexRange()); !it.atEnd(); ++it) { island_center += vh.get(*it); }
-		island_center /= prim->getVertexCount();
-		island_center.z() = 0.0;
-		// Calc source prim area and uv_area
-		source_prim_area = prim->calcArea();
-		UT_Vector3R v1 = vh.get(prim->getVertexOffset(1)) - vh.get(prim->getVertexOffset(0));
-		UT_Vector3R v2 = vh.get(prim->getVertexOffset(3)) - vh.get(prim->getVertexOffset(0));
-		uv_area = v1.length() * v2.length();
-	}
-
-	for (const auto &subelem : subelements) {
-		exint num_coords = subelem.coords.entries();
-		GA_Offset point_block = gdp->appendPointBlock(num_coords * 2);
-		GA_OffsetArray top_ptoffs;
-		top_ptoffs.clear();
-		for (exint i = 0; i < num_coords; i++) {
-			bool last(i == (num_coords - 1));
-			const UT_Vector2R &coord0 = subelem.coords(i);
-			const UT_Vector2R &coord1 = subelem.coords((last ? 0 : i + 1));
-			UT_Vector4F pt0, pt1, pt2, pt3;
-			GA_Offset ptof0 = point_block + i*2;
-			GA_Offset ptof1 = point_block + i*2 + 1;
-			GA_Offset ptof2 = point_block + (last ? 0 : i*2 + 2);
-			GA_Offset ptof3 = point_block + (last ? 1 : i*2 + 3);
-			top_ptoffs.append(ptof1);
-			prim->evaluateInteriorPoint(pt0, coord0.x(), coord0.y());
-			prim->evaluateInteriorPoint(pt1, coord1.x(), coord1.y());
-			ph.set(ptof0, UT_Vector3F(pt0));
-			ph.set(ptof2, UT_Vector3F(pt1));
-			
-			ph.set(ptof1, UT_Vector3F(pt0) + primN * height);
-			ph.set(ptof3, UT_Vector3F(pt1) + primN * height);
-			
-			auto new_prim = GEO_PrimPoly::build(gdp, 4, false, false);
-			result_prims.append(new_prim);
-			new_prim->setVertexPoint(0, ptof0);
-			new_prim->setVertexPoint(1, ptof2);
-			new_prim->setVertexPoint(2, ptof3);
-			new_prim->setVertexPoint(3, ptof1);
-			if (this->unwrapuvs) {
-				prim->evaluateInteriorPoint(new_prim->getVertexOffset(0), vertex_refmap, coord0.x(), coord0.y());
-				prim->evaluateInteriorPoint(new_prim->getVertexOffset(1), vertex_refmap, coord1.x(), coord1.y());
-				vertex_refmap.copyValue(GA_ATTRIB_VERTEX, new_prim->getVertexOffset(2), GA_ATTRIB_VERTEX, new_prim->getVertexOffset(1));
-				vertex_refmap.copyValue(GA_ATTRIB_VERTEX, new_prim->getVertexOffset(3), GA_ATTRIB_VERTEX, new_prim->getVertexOffset(0));
-				
-				UT_Vector3R edge = vh.get(new_prim->getVertexOffset(1)) - vh.get(new_prim->getVertexOffset(0));
-				fpreal uv_edge_len = edge.length();
-				fpreal extruded_prim_area = new_prim->calcArea();
-				fpreal uv_extruded_area = (extruded_prim_area * uv_area) / source_prim_area;
-				fpreal offset_val = uv_extruded_area / uv_edge_len;
-				UT_Vector3R vc = island_center - vh.get(new_prim->getVertexOffset(0));
-				UT_Vector3R vv = vh.get(new_prim->getVertexOffset(1)) - vh.get(new_prim->getVertexOffset(0));
-				fpreal proj = vc.dot(vv) / vv.length();
-				vv.normalize();
-				UT_Vector3R projpoint = vh.get(new_prim->getVertexOffset(0)) + vv * proj;
-				UT_Vector3R offset_dir = projpoint - island_center;
-				offset_dir.normalize();
-				
-				vh.add(new_prim->getVertexOffset(0), offset_dir * offset_val);
-				vh.add(new_prim->getVertexOffset(1), offset_dir * offset_val);
-
-			}
-			if (elem_group != nullptr)
-				elem_group->add(new_prim);
-			
-		}
-		auto top_prim = GEO_PrimPoly::build(gdp, num_coords, false, false);
-		result_prims.append(top_prim);
-		for (int j = 0; j < num_coords; j++) {
-			top_prim->setVertexPoint(j, top_ptoffs(j));
-			auto vtxoff = top_prim->getVertexOffset(j);
-			if (this->unwrapuvs)
-				prim->evaluateInteriorPoint(vtxoff, vertex_refmap, subelem.coords(j).x(), subelem.coords(j).y());
-		}
-		if (inherit_prim_attrs) {
-			for (auto const &each : result_prims) {
-				prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, each->getMapOffset(), GA_ATTRIB_PRIMITIVE, prim->getMapOffset());
-			}
-		}
-		if (elem_front_group != nullptr)
-			elem_front_group->add(top_prim);
-	}
-}
-
-exint Element::num_points()
-{
-	exint num = 0;
-	for (const auto &elem : subelements) {
-		num += elem.coords.entries();
-	}
-	return num;
-}
-
-
-std::unique_ptr<Element> 
-make_element(const ElementTypes &elem_type, 
-			const short &dir,
-			bool inherit_prim_attrs,
-			bool unwrapuvs,
-			GA_AttributeRefMap &prim_refmap,
-			GA_Attribute *uvattr,
-			GA_PrimitiveGroup *elem_grp,
-			GA_PrimitiveGroup *elem_front_grp) 
-{
-	std::unique_ptr<Element> w(new Element(elem_type, dir, uvattr, elem_grp, elem_front_grp));
-	w->unwrapuvs = unwrapuvs;
-	w->inherit_prim_attrs = inherit_prim_attrs;
-	w->prim_refmap = prim_refmap;
-	uint num_elems = 1;
-	if (elem_type <= ElementTypes::STRIPE3)
-	{
-		switch (elem_type)
-		{
-		case ElementTypes::STRIPE2:
-			num_elems = 2;
-			break;
-		case ElementTypes:: STRIPE3:
-			num_elems = 3;
-			break;
-		default:
-			break;
-		}
-
-		V2R pt0, pt1, pt2, pt3;
-		if (dir == 0) {
-			pt0 = V2R(0.0, 0.0);
-			pt1 = V2R(0.0, 1.0);
-			pt2 = V2R(0.1, 1.0);
-			pt3 = V2R(0.1, 0.0);
-		}
-		else {
-			pt0 = V2R(0.0, 0.0);
-			pt1 = V2R(0.0, 0.1);
-			pt2 = V2R(1.0, 0.1);
-			pt3 = V2R(1.0, 0.0);
-		}
-
-		for (uint i = 0; i < num_elems; i++) {
-			auto elem = SubElem();
-			fpreal step = i / 8.0;
-			auto new_pt0 = pt0;
-			new_pt0(dir) += step;
-			elem.coords.append(new_pt0);
-			auto new_pt1 = pt1;
-			new_pt1(dir) += step;
-			elem.coords.append(new_pt1);
-			auto new_pt2 = pt2;
-			new_pt2(dir) += step;
-			elem.coords.append(new_pt2);
-			auto new_pt3 = pt3;
-			new_pt3(dir) += step;
-			elem.coords.append(new_pt3);
-			w->append(elem);
-		}
-	}
-	else if (elem_type == ElementTypes::TSHAPE)
-	{
-		auto elem = SubElem();
-		if (dir == 0) {
-			elem.coords.append(V2R(0.0, 0.0));
-			elem.coords.append(V2R(0.0, 0.99));
-			elem.coords.append(V2R(0.33, 0.99));
-			elem.coords.append(V2R(0.33, 0.66));
-			elem.coords.append(V2R(0.66, 0.66));
-			elem.coords.append(V2R(0.66, 0.33));
-			elem.coords.append(V2R(0.33, 0.33));
-			elem.coords.append(V2R(0.33, 0.0));
-		}
-		else {
-			elem.coords.append(V2R(0.0, 0.0));
-			elem.coords.append(V2R(0.0, 0.33));
-			elem.coords.append(V2R(0.33, 0.33));
-			elem.coords.append(V2R(0.33, 0.66));
-			elem.coords.append(V2R(0.66, 0.66));
-			elem.coords.append(V2R(0.66, 0.33));
-			elem.coords.append(V2R(0.99, 0.33));
-			elem.coords.append(V2R(0.99, 0.0));
-		}
-		w->append(elem);
-	}
-
-	else if (elem_type == ElementTypes::SQUARE)
-	{
-		auto elem = SubElem();
-		elem.coords.append(V2R(0.0, 0.0));
-		elem.coords.append(V2R(0.0, 0.5));
-		elem.coords.append(V2R(0.5, 0.5));
-		elem.coords.append(V2R(0.5, 0.0));
-		w->append(elem);
-	}
-	else if (elem_type == ElementTypes::RSHAPE)
-	{
-		auto elem = SubElem();
-		if (dir == 0) {
-			elem.coords.append(V2R(0.99, 0.33));
-			elem.coords.append(V2R(0.99, 0.0));
-			elem.coords.append(V2R(0.0, 0.0));
-			elem.coords.append(V2R(0.0, 0.66));
-			elem.coords.append(V2R(0.33, 0.66));
-			elem.coords.append(V2R(0.33, 0.33));
-		}
-		else {
-			elem.coords.append(V2R(0.33, 0.0));
-			elem.coords.append(V2R(0.0, 0.00));
-			elem.coords.append(V2R(0.0, 0.99));
-			elem.coords.append(V2R(0.66, 0.99));
-			elem.coords.append(V2R(0.66, 0.66));
-			elem.coords.append(V2R(0.33, 0.66));
-
-		}
-		w->append(elem);
-	}
-	else if (elem_type == ElementTypes::TRIANGLE)
-	{
-		auto elem = SubElem();
-		elem.coords.append(V2R(0.0, 0.0));
-		elem.coords.append(V2R(0.0, 0.5));
-		elem.coords.append(V2R(0.5, 0.0));
-		w->append(elem);
-	}
-	return w;
-}
+#include "Element.h"
+#include <GEO/GEO_PrimPoly.h>
+#include <UT/UT_Pair.h>
+#include <UT/UT_Swap.h>
+#include "Triangulate.h"
+#include "Bevel.h"
+#include "UVFrame.h"
+#include "UVAtlas.h"
+#include "misc.h"
+#include <UT/UT_Vector3Array.h>
+#include <SYS/SYS_Math.h>
+#include <GA/GA_AttributeRefMap.h>
+#include <GA/GA_ElementWrangler.h>
+
+typedef UT_Vector2R V2R;
+typedef UT_Pair<GA_Offset, GA_Offset> OffsetPair;
+
+Element::Element(ElementTypes type, const short &direction, GA_Attribute *uvattr, GA_PrimitiveGroup *elem_grp, GA_PrimitiveGroup *elem_front_grp,
+				 CoordStore *store)
+	:library_shape(-1), atlas(nullptr), base_rings(nullptr), cap_base(false), type(type), direction(direction), flipped(false), xform{ { 1.0, 1.0 }, { 0.0, 0.0 } },
+	elem_group(elem_grp), elem_front_group(elem_front_grp), uvattr(uvattr)
+{
+	xs.bind(store != nullptr ? &store->xs : &own_xs);
+	ys.bind(store != nullptr ? &store->ys : &own_ys);
+	offsets.append(0);
+}
+
+
+Element::~Element()
+{
+}
+
+
+void Element::retarget(GA_Attribute *new_uvattr, GA_PrimitiveGroup *elem_grp, GA_PrimitiveGroup *elem_front_grp)
+{
+	uvattr = new_uvattr;
+	elem_group = elem_grp;
+	elem_front_group = elem_front_grp;
+}
+
+
+BBox2D Element::bbox()
+{
+	hreeble::OutlineBounds bounds = hreeble::outline_bounds(xs.data(), ys.data(), num_points());
+	BBox2D bbox = { UT_Vector2R(bounds.min[0], bounds.min[1]), UT_Vector2R(bounds.max[0], bounds.max[1]) };
+	return bbox;
+}
+
+
+UT_Vector2R Element::pivot()
+{
+	UT_Vector2R pivot;
+	hreeble::outline_pivot(xs.data(), ys.data(), num_points(), pivot.data());
+	return pivot;
+}
+
+
+UT_Vector2R Element::bounds_intersection()
+{
+	UT_Vector2R offset;
+	hreeble::bounds_offset(xs.data(), ys.data(), num_points(), offset.data());
+	return offset;
+}
+
+
+void Element::append(std::initializer_list<UT_Vector2R> coords)
+{
+	for (const auto &pt : coords) {
+		xs.append(pt.x());
+		ys.append(pt.y());
+	}
+	offsets.append(xs.entries());
+	hole_flags.append(0);
+}
+
+
+void Element::append(const fpreal32 *x, const fpreal32 *y, const exint &num, const bool reverse, const bool hole)
+{
+	for (exint i = 0; i < num; i++) {
+		exint src = reverse ? num - 1 - i : i;
+		xs.append(x[src]);
+		ys.append(y[src]);
+	}
+	offsets.append(xs.entries());
+	hole_flags.append(hole ? 1 : 0);
+}
+
+
+bool Element::has_holes() const
+{
+	for (const auto &flag : hole_flags) {
+		if (flag)
+			return true;
+	}
+	return false;
+}
+
+
+void Element::flip()
+{
+	// Only asymmetric shapes change when mirrored
+	if (type == ElementTypes::TSHAPE || type == ElementTypes::RSHAPE || type == ElementTypes::CUSTOM) {
+		CoordRun &mirrored = direction == 0 ? xs : ys;
+		for (exint s = 0; s < num_subelements(); s++) {
+			exint first = offsets(s), last = offsets(s + 1) - 1;
+			for (; first < last; first++, last--) {
+				UTswap(xs(first), xs(last));
+				UTswap(ys(first), ys(last));
+			}
+		}
+		exint num = num_points();
+		for (exint i = 0; i < num; i++) {
+			mirrored(i) = 1 - mirrored(i);
+		}
+		flipped = !flipped;
+	}
+}
+
+
+void Element::transform(const UT_Vector2R & new_pos, const fpreal & scale, const bool flip)
+{
+	if (flip)
+		this->flip();
+	UT_Vector2R target = new_pos;
+	if (type == ElementTypes::TRIANGLE) {
+		target(0) = SYSfit01(new_pos(0), 0.0, 1 - new_pos(1));
+		target(1) = SYSfit01(new_pos(1), 0.0, 1 - new_pos(0));
+	}
+	hreeble::place_outline(xs.data(), ys.data(), num_points(), target.data(), scale, xform);
+}
+
+
+
+void Element::build(GU_Detail *gdp, const GEO_Primitive *prim, const UT_Vector3F &primN, const fpreal & height, const bool side_walls,
+					const UT_IntArray *cap_triangles, const BevelProfile *bevel, const fpreal &bevel_size,
+					UT_ValArray<GEO_Primitive*> *caps)
+{
+	GA_RWHandleV3 ph(gdp->getP());
+	GA_RWHandleV3D vh;
+	UT_Array<GEO_PrimPoly*> result_prims;
+	UVFrame uv_frame;
+	// Atlas charts replace the unwrap around the host island
+	bool frame_uvs = unwrapuvs && atlas == nullptr;
+	if (frame_uvs) {
+		vh = uvattr;
+		// Hosts stay in the target when building into a buffer
+		const GA_Detail &host_detail = prim->getDetail();
+		uv_frame.init(prim, &host_detail == gdp ? uvattr : host_detail.findAttribute(GA_ATTRIB_VERTEX, uvattr->getName()));
+	}
+
+	// Ring 0 is the base, ring 1 the wall top, bevel rings follow up to the cap
+	bool bevelled = side_walls && bevel != nullptr && !bevel->is_flat() && bevel_size > 0.0;
+	exint num_rings = side_walls ? (bevelled ? bevel->num_rows() + 1 : 2) : 1;
+	fpreal size = 0.0;
+	fpreal su = 1.0, sv = 1.0;
+	CoordArray miter_xs, miter_ys;
+	// Normals are flat per face, caps share the host u direction as tangent
+	bool write_frames = normal_handle.isValid() && tangent_handle.isValid();
+	UT_Vector3 cap_tangent(1.0f, 0.0f, 0.0f);
+	if (bevelled || atlas != nullptr || write_frames) {
+		UT_Vector3D center, dpdu, dpdv;
+		host_derivs(prim, pivot(), center, dpdu, dpdv);
+		su = SYSmax(dpdu.length(), 1e-6);
+		sv = SYSmax(dpdv.length(), 1e-6);
+		cap_tangent = UT_Vector3(dpdu);
+	}
+	if (bevelled) {
+		// Keep opposite rings from crossing on thin elements
+		BBox2D box = bbox();
+		size = SYSmin(bevel_size, 0.25 * SYSmin((box.maxvec.x() - box.minvec.x()) * su, (box.maxvec.y() - box.minvec.y()) * sv));
+		miter_xs.setSize(num_points());
+		miter_ys.setSize(num_points());
+		for (exint s = 0; s < num_subelements(); s++) {
+			exint start = subelem_start(s);
+			hreeble::outline_miters(xs.data() + start, ys.data() + start, subelem_size(s), su, sv, hole_flags(s) != 0,
+									miter_xs.data() + start, miter_ys.data() + start);
+		}
+	}
+	auto ring_coord = [&](const exint &index, const exint &ring) {
+		if (!bevelled || ring == 0)
+			return coord(index);
+		fpreal inset = bevel->inset(ring - 1) * size;
+		return UT_Vector2R(xs(index) + miter_xs(index) * inset, ys(index) + miter_ys(index) * inset);
+	};
+	auto ring_lift = [&](const exint &ring) {
+		if (!side_walls)
+			return height;
+		if (ring == 0)
+			return fpreal(0.0);
+		return bevelled ? height - bevel->drop(ring - 1) * size : height;
+	};
+
+	// Triangulated caps span sub-elements (holes), so they're emitted after all the walls
+	GA_OffsetArray top_points;
+	if (cap_triangles != nullptr)
+		top_points.setSize(num_points());
+	// Ring uvs of every outline point, walls and caps only write them out
+	UT_Array<UT_Vector3R> ring_uvs;
+	UT_Vector3Array base_pos;
+	if (frame_uvs)
+		ring_uvs.setSize(num_points() * num_rings);
+	GA_OffsetArray base_points;
+	base_points.setSize(num_points());
+	int cap_chart = atlas != nullptr ? atlas->new_chart() : -1;
+	auto add_cap_uv = [&](const GA_Offset &vtx, const exint &index) {
+		const UT_Vector2R rc = ring_coord(index, num_rings - 1);
+		atlas->add(cap_chart, vtx, rc.x() * su, rc.y() * sv);
+	};
+	for (exint s = 0; s < num_subelements(); s++) {
+		exint start = subelem_start(s);
+		exint num_coords = subelem_size(s);
+		GA_Offset point_block = gdp->appendPointBlock(num_coords * num_rings);
+		GA_OffsetArray top_ptoffs;
+		top_ptoffs.clear();
+		base_pos.setSize(num_coords);
+		for (exint i = 0; i < num_coords; i++) {
+			UT_Vector4F pt;
+			for (exint r = 0; r < num_rings; r++) {
+				const UT_Vector2R rc = ring_coord(start + i, r);
+				prim->evaluateInteriorPoint(pt, rc.x(), rc.y());
+				ph.set(point_block + i*num_rings + r, UT_Vector3F(pt) + primN * ring_lift(r));
+				if (r == 0)
+					base_pos(i) = UT_Vector3F(pt);
+				if (frame_uvs) {
+					exint uv_index = (start + i)*num_rings + r;
+					// The wall top shares the base outline
+					ring_uvs(uv_index) = r == 1 ? ring_uvs(uv_index - 1) : uv_frame.uv_at(rc.x(), rc.y());
+				}
+			}
+			top_ptoffs.append(point_block + i*num_rings + num_rings - 1);
+		}
+		// Walls of a sub-element unroll into one strip chart, bevel strips stack on top
+		int wall_chart = atlas != nullptr && side_walls ? atlas->new_chart() : -1;
+		fpreal32 wall_run = 0.0f;
+		for (exint i = 0; i < num_coords && side_walls; i++) {
+			bool last(i == (num_coords - 1));
+			exint next = last ? 0 : i + 1;
+			GA_Offset ptof0 = point_block + i*num_rings;
+			GA_Offset ptof1 = point_block + i*num_rings + 1;
+			GA_Offset ptof2 = point_block + next*num_rings;
+			GA_Offset ptof3 = point_block + next*num_rings + 1;
+			
+			auto new_prim = GEO_PrimPoly::build(gdp, 4, false, false);
+			result_prims.append(new_prim);
+			new_prim->setVertexPoint(0, ptof0);
+			new_prim->setVertexPoint(1, ptof2);
+			new_prim->setVertexPoint(2, ptof3);
+			new_prim->setVertexPoint(3, ptof1);
+			if (frame_uvs) {
+				const UT_Vector3R &uv0 = ring_uvs((start + i)*num_rings);
+				const UT_Vector3R &uv1 = ring_uvs((start + next)*num_rings);
+				// Walls rise straight along the normal, their area is the projected edge times the height
+				fpreal wall_area = cross(base_pos(next) - base_pos(i), primN).length() * ring_lift(1);
+				UT_Vector3R offset = uv_frame.wall_offset(uv0, uv1, wall_area);
+				vh.set(new_prim->getVertexOffset(0), uv0 + offset);
+				vh.set(new_prim->getVertexOffset(1), uv1 + offset);
+				vh.set(new_prim->getVertexOffset(2), uv1);
+				vh.set(new_prim->getVertexOffset(3), uv0);
+			}
+			fpreal32 edge_len = 0.0f;
+			if (wall_chart >= 0) {
+				edge_len = (base_pos(next) - base_pos(i)).length();
+				fpreal32 top = ring_lift(1);
+				atlas->add(wall_chart, new_prim->getVertexOffset(0), wall_run, 0.0f);
+				atlas->add(wall_chart, new_prim->getVertexOffset(1), wall_run + edge_len, 0.0f);
+				atlas->add(wall_chart, new_prim->getVertexOffset(2), wall_run + edge_len, top);
+				atlas->add(wall_chart, new_prim->getVertexOffset(3), wall_run, top);
+			}
+			if (elem_group != nullptr)
+				elem_group->add(new_prim);
+			UT_Vector3 edge_dir = base_pos(next) - base_pos(i);
+			if (write_frames)
+				hreeble::set_vertex_frame(normal_handle, tangent_handle, new_prim, primN, edge_dir);
+
+			// Bevel strips take the band between the outline and the inset cap in uv
+			for (exint r = 1; r + 1 < num_rings; r++) {
+				auto bevel_prim = GEO_PrimPoly::build(gdp, 4, false, false);
+				result_prims.append(bevel_prim);
+				bevel_prim->setVertexPoint(0, point_block + i*num_rings + r);
+				bevel_prim->setVertexPoint(1, point_block + next*num_rings + r);
+				bevel_prim->setVertexPoint(2, point_block + next*num_rings + r + 1);
+				bevel_prim->setVertexPoint(3, point_block + i*num_rings + r + 1);
+				if (frame_uvs) {
+					const exint corners[] = { start + i, start + next, start + next, start + i };
+					for (int j = 0; j < 4; j++)
+						vh.set(bevel_prim->getVertexOffset(j), ring_uvs(corners[j]*num_rings + r + (j < 2 ? 0 : 1)));
+				}
+				if (wall_chart >= 0) {
+					// Profile length walked from the wall top
+					fpreal32 v0 = ring_lift(1) + (bevel->arc(0) - bevel->arc(r - 1)) * size;
+					fpreal32 v1 = ring_lift(1) + (bevel->arc(0) - bevel->arc(r)) * size;
+					atlas->add(wall_chart, bevel_prim->getVertexOffset(0), wall_run, v0);
+					atlas->add(wall_chart, bevel_prim->getVertexOffset(1), wall_run + edge_len, v0);
+					atlas->add(wall_chart, bevel_prim->getVertexOffset(2), wall_run + edge_len, v1);
+					atlas->add(wall_chart, bevel_prim->getVertexOffset(3), wall_run, v1);
+				}
+				if (elem_group != nullptr)
+					elem_group->add(bevel_prim);
+				if (write_frames)
+					hreeble::set_vertex_frame(normal_handle, tangent_handle, bevel_prim, primN, edge_dir);
+			}
+			wall_run += edge_len;
+		}
+		if (cap_triangles != nullptr) {
+			for (exint j = 0; j < num_coords; j++)
+				top_points(start + j) = top_ptoffs(j);
+		}
+		else {
+			auto top_prim = GEO_PrimPoly::build(gdp, num_coords, false, false);
+			result_prims.append(top_prim);
+			for (int j = 0; j < num_coords; j++) {
+				top_prim->setVertexPoint(j, top_ptoffs(j));
+				auto vtxoff = top_prim->getVertexOffset(j);
+				if (frame_uvs)
+					vh.set(vtxoff, ring_uvs((start + j)*num_rings + num_rings - 1));
+				if (cap_chart >= 0)
+					add_cap_uv(vtxoff, start + j);
+			}
+			if (elem_front_group != nullptr)
+				elem_front_group->add(top_prim);
+			if (write_frames)
+				hreeble::set_vertex_frame(normal_handle, tangent_handle, top_prim, primN, cap_tangent);
+			if (caps != nullptr)
+				caps->append(top_prim);
+		}
+		if (side_walls) {
+			for (exint j = 0; j < num_coords; j++)
+				base_points(start + j) = point_block + j*num_rings;
+		}
+		if (base_rings != nullptr && side_walls) {
+			BaseRing &ring = (*base_rings)(base_rings->append());
+			ring.hole = hole_flags(s) != 0;
+			for (exint j = 0; j < num_coords; j++) {
+				ring.points.append(base_points(start + j));
+				ring.coords.append(coord(start + j));
+			}
+		}
+		if (inherit_prim_attrs) {
+			for (auto const &each : result_prims) {
+				prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, each->getMapOffset(), GA_ATTRIB_PRIMITIVE, prim->getMapOffset());
+			}
+		}
+	}
+	if (cap_triangles != nullptr) {
+		for (exint t = 0; t < cap_triangles->entries(); t += 3) {
+			auto tri = GEO_PrimPoly::build(gdp, 3, false, false);
+			for (int j = 0; j < 3; j++) {
+				exint index = (*cap_triangles)(t + j);
+				tri->setVertexPoint(j, top_points(index));
+				if (frame_uvs)
+					vh.set(tri->getVertexOffset(j), ring_uvs(index*num_rings + num_rings - 1));
+				if (cap_chart >= 0)
+					add_cap_uv(tri->getVertexOffset(j), index);
+			}
+			if (inherit_prim_attrs)
+				prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, tri->getMapOffset(), GA_ATTRIB_PRIMITIVE, prim->getMapOffset());
+			if (elem_front_group != nullptr)
+				elem_front_group->add(tri);
+			if (write_frames)
+				hreeble::set_vertex_frame(normal_handle, tangent_handle, tri, primN, cap_tangent);
+			if (caps != nullptr)
+				caps->append(tri);
+		}
+	}
+	if (cap_base && side_walls) {
+		// Closes the element from below on the shared base points, facing into the host
+		int base_chart = atlas != nullptr ? atlas->new_chart() : -1;
+		auto build_base = [&](const exint &num, const std::function<exint(exint)> &index) {
+			auto base_prim = GEO_PrimPoly::build(gdp, num, false, false);
+			for (exint j = 0; j < num; j++) {
+				exint k = index(num - 1 - j);
+				base_prim->setVertexPoint(j, base_points(k));
+				if (frame_uvs)
+					vh.set(base_prim->getVertexOffset(j), ring_uvs(k*num_rings));
+				if (base_chart >= 0)
+					atlas->add(base_chart, base_prim->getVertexOffset(j), xs(k) * su, ys(k) * sv);
+			}
+			if (inherit_prim_attrs)
+				prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, base_prim->getMapOffset(), GA_ATTRIB_PRIMITIVE, prim->getMapOffset());
+			if (elem_group != nullptr)
+				elem_group->add(base_prim);
+			if (write_frames)
+				hreeble::set_vertex_frame(normal_handle, tangent_handle, base_prim, -primN, cap_tangent);
+		};
+		if (cap_triangles != nullptr) {
+			for (exint t = 0; t < cap_triangles->entries(); t += 3)
+				build_base(3, [&](exint j) { return exint((*cap_triangles)(t + j)); });
+		}
+		else {
+			for (exint s = 0; s < num_subelements(); s++)
+				build_base(subelem_size(s), [&](exint j) { return subelem_start(s) + j; });
+		}
+	}
+}
+
+fpreal Element::world_size(const GEO_Primitive *prim, UT_Vector3 &center)
+{
+	BBox2D bbox = this->bbox();
+	UT_Vector2R pv = pivot();
+	UT_Vector4 pmin, pmax, pcenter;
+	prim->evaluateInteriorPoint(pmin, bbox.minvec.x(), bbox.minvec.y());
+	prim->evaluateInteriorPoint(pmax, bbox.maxvec.x(), bbox.maxvec.y());
+	prim->evaluateInteriorPoint(pcenter, pv.x(), pv.y());
+	center = UT_Vector3(pcenter);
+	return (UT_Vector3(pmax) - UT_Vector3(pmin)).length();
+}
+
+
+bool Element::merge_subelements()
+{
+	// Collapse stripes into a single quad covering all of them
+	if (num_subelements() < 2)
+		return false;
+	BBox2D bbox = this->bbox();
+	// Rewritten in place, the quad never outgrows the stripes
+	xs.clear();
+	ys.clear();
+	offsets.setSize(1);
+	hole_flags.clear();
+	append({ V2R(bbox.minvec.x(), bbox.minvec.y()),
+			 V2R(bbox.minvec.x(), bbox.maxvec.y()),
+			 V2R(bbox.maxvec.x(), bbox.maxvec.y()),
+			 V2R(bbox.maxvec.x(), bbox.minvec.y()) });
+	return true;
+}
+
+
+void Element::triangulate(UT_IntArray &triangles)
+{
+	// Every solid sub-element together with the holes following it
+	triangles.clear();
+	UT_Array<UT_IntArray> outlines;
+	for (exint s = 0; s <= num_subelements(); s++) {
+		if (s == num_subelements() || !hole_flags(s)) {
+			if (outlines.entries() != 0)
+				hreeble::triangulate(xs.data(), ys.data(), outlines, triangles);
+			outlines.clear();
+			if (s == num_subelements())
+				break;
+		}
+		UT_IntArray &outline = outlines(outlines.append());
+		for (exint i = offsets(s); i < offsets(s + 1); i++)
+			outline.append(int(i));
+	}
+}
+
+
+void Element::build_prototype(GU_Detail *proto, const UT_IntArray *cap_triangles)
+{
+	// Unit square layout, extruded from z=0 to z=1. Placements scale it by the element height.
+	GA_RWHandleV3 ph(proto->getP());
+	GA_OffsetArray top_points;
+	if (cap_triangles != nullptr)
+		top_points.setSize(num_points());
+	for (exint s = 0; s < num_subelements(); s++) {
+		exint start = subelem_start(s);
+		exint num_coords = subelem_size(s);
+		GA_Offset point_block = proto->appendPointBlock(num_coords * 2);
+		for (exint i = 0; i < num_coords; i++) {
+			ph.set(point_block + i*2, UT_Vector3(xs(start + i), ys(start + i), 0.0));
+			ph.set(point_block + i*2 + 1, UT_Vector3(xs(start + i), ys(start + i), 1.0));
+		}
+		for (exint i = 0; i < num_coords; i++) {
+			bool last(i == (num_coords - 1));
+			auto new_prim = GEO_PrimPoly::build(proto, 4, false, false);
+			new_prim->setVertexPoint(0, point_block + i*2);
+			new_prim->setVertexPoint(1, point_block + (last ? 0 : i*2 + 2));
+			new_prim->setVertexPoint(2, point_block + (last ? 1 : i*2 + 3));
+			new_prim->setVertexPoint(3, point_block + i*2 + 1);
+		}
+		if (cap_triangles != nullptr) {
+			for (exint j = 0; j < num_coords; j++)
+				top_points(start + j) = point_block + j*2 + 1;
+			continue;
+		}
+		auto top_prim = GEO_PrimPoly::build(proto, num_coords, false, false);
+		for (exint j = 0; j < num_coords; j++) {
+			top_prim->setVertexPoint(j, point_block + j*2 + 1);
+		}
+	}
+	if (cap_triangles != nullptr) {
+		for (exint t = 0; t < cap_triangles->entries(); t += 3) {
+			auto tri = GEO_PrimPoly::build(proto, 3, false, false);
+			for (int j = 0; j < 3; j++)
+				tri->setVertexPoint(j, top_points((*cap_triangles)(t + j)));
+		}
+	}
+}
+
+
+void Element::instance_xform(const GEO_Primitive *prim, const UT_Vector3 &primN, const fpreal &height, UT_Matrix3D &xform, UT_Vector3D &pos)
+{
+	// Linearize the host parametrization around the element pivot so skewed and
+	// tapered faces still get a good fit. Exact for parallelograms.
+	UT_Vector2R pv = pivot();
+	UT_Vector3D center, dpdu, dpdv;
+	host_derivs(prim, pv, center, dpdu, dpdv);
+
+	UT_Vector2R d = UT_Vector2R(xform.origin[0], xform.origin[1]) - pv;
+	pos = center + dpdu * d.x() + dpdv * d.y();
+	UT_Vector3D x = dpdu * xform.scale[0];
+	UT_Vector3D y = dpdv * xform.scale[1];
+	UT_Vector3D z = UT_Vector3D(primN) * height;
+	xform = UT_Matrix3D(x.x(), x.y(), x.z(),
+						y.x(), y.y(), y.z(),
+						z.x(), z.y(), z.z());
+}
+
+
+void Element::host_derivs(const GEO_Primitive *prim, const UT_Vector2R &at, UT_Vector3D &center, UT_Vector3D &dpdu, UT_Vector3D &dpdv)
+{
+	const fpreal delta = 0.005;
+	UT_Vector4 c, pu0, pu1, pv0, pv1;
+	fpreal u0 = SYSmax(at.x() - delta, 0.0), u1 = SYSmin(at.x() + delta, 1.0);
+	fpreal v0 = SYSmax(at.y() - delta, 0.0), v1 = SYSmin(at.y() + delta, 1.0);
+	prim->evaluateInteriorPoint(c, at.x(), at.y());
+	prim->evaluateInteriorPoint(pu0, u0, at.y());
+	prim->evaluateInteriorPoint(pu1, u1, at.y());
+	prim->evaluateInteriorPoint(pv0, at.x(), v0);
+	prim->evaluateInteriorPoint(pv1, at.x(), v1);
+	center = UT_Vector3D(UT_Vector3(c));
+	dpdu = UT_Vector3D(UT_Vector3(pu1) - UT_Vector3(pu0)) / (u1 - u0);
+	dpdv = UT_Vector3D(UT_Vector3(pv1) - UT_Vector3(pv0)) / (v1 - v0);
+}
+
+
+exint Element::prototype_key() const
+{
+	exint index = 0;
+	switch (type)
+	{
+	case ElementTypes::STRIPE: index = 0; break;
+	case ElementTypes::STRIPE2: index = 1; break;
+	case ElementTypes::STRIPE3: index = 2; break;
+	case ElementTypes::TSHAPE: index = 3; break;
+	case ElementTypes::RSHAPE: index = 4; break;
+	case ElementTypes::SQUARE: index = 5; break;
+	case ElementTypes::TRIANGLE: index = 6; break;
+	case ElementTypes::CUSTOM: index = NUM_BUILTIN_SHAPES + library_shape; break;
+	}
+	return index * PROTOTYPE_VARIANTS + direction * 2 + (flipped ? 1 : 0);
+}
+
+
+exint Element::num_points()
+{
+	return xs.entries();
+}
+
+
+std::unique_ptr<Element> 
+make_element(const ElementTypes &elem_type, 
+			const short &dir,
+			bool inherit_prim_attrs,
+			bool unwrapuvs,
+			GA_AttributeRefMap &prim_refmap,
+			GA_Attribute *uvattr,
+			GA_PrimitiveGroup *elem_grp,
+			GA_PrimitiveGroup *elem_front_grp,
+			CoordStore *store)
+{
+	std::unique_ptr<Element> w(new Element(elem_type, dir, uvattr, elem_grp, elem_front_grp, store));
+	w->unwrapuvs = unwrapuvs;
+	w->inherit_prim_attrs = inherit_prim_attrs;
+	w->prim_refmap = prim_refmap;
+	uint num_elems = 1;
+	if (elem_type <= ElementTypes::STRIPE3)
+	{
+		switch (elem_type)
+		{
+		case ElementTypes::STRIPE2:
+			num_elems = 2;
+			break;
+		case ElementTypes:: STRIPE3:
+			num_elems = 3;
+			break;
+		default:
+			break;
+		}
+
+		V2R pt0, pt1, pt2, pt3;
+		if (dir == 0) {
+			pt0 = V2R(0.0, 0.0);
+			pt1 = V2R(0.0, 1.0);
+			pt2 = V2R(0.1, 1.0);
+			pt3 = V2R(0.1, 0.0);
+		}
+		else {
+			pt0 = V2R(0.0, 0.0);
+			pt1 = V2R(0.0, 0.1);
+			pt2 = V2R(1.0, 0.1);
+			pt3 = V2R(1.0, 0.0);
+		}
+
+		for (uint i = 0; i < num_elems; i++) {
+			fpreal step = i / 8.0;
+			auto new_pt0 = pt0;
+			new_pt0(dir) += step;
+			auto new_pt1 = pt1;
+			new_pt1(dir) += step;
+			auto new_pt2 = pt2;
+			new_pt2(dir) += step;
+			auto new_pt3 = pt3;
+			new_pt3(dir) += step;
+			w->append({ new_pt0, new_pt1, new_pt2, new_pt3 });
+		}
+	}
+	else if (elem_type == ElementTypes::TSHAPE)
+	{
+		if (dir == 0) {
+			w->append({ V2R(0.0, 0.0), V2R(0.0, 0.99), V2R(0.33, 0.99), V2R(0.33, 0.66),
+						V2R(0.66, 0.66), V2R(0.66, 0.33), V2R(0.33, 0.33), V2R(0.33, 0.0) });
+		}
+		else {
+			w->append({ V2R(0.0, 0.0), V2R(0.0, 0.33), V2R(0.33, 0.33), V2R(0.33, 0.66),
+						V2R(0.66, 0.66), V2R(0.66, 0.33), V2R(0.99, 0.33), V2R(0.99, 0.0) });
+		}
+	}
+
+	else if (elem_type == ElementTypes::SQUARE)
+	{
+		w->append({ V2R(0.0, 0.0), V2R(0.0, 0.5), V2R(0.5, 0.5), V2R(0.5, 0.0) });
+	}
+	else if (elem_type == ElementTypes::RSHAPE)
+	{
+		if (dir == 0) {
+			w->append({ V2R(0.99, 0.33), V2R(0.99, 0.0), V2R(0.0, 0.0),
+						V2R(0.0, 0.66), V2R(0.33, 0.66), V2R(0.33, 0.33) });
+		}
+		else {
+			w->append({ V2R(0.33, 0.0), V2R(0.0, 0.00), V2R(0.0, 0.99),
+						V2R(0.66, 0.99), V2R(0.66, 0.66), V2R(0.33, 0.66) });
+		}
+	}
+	else if (elem_type == ElementTypes::TRIANGLE)
+	{
+		w->append({ V2R(0.0, 0.0), V2R(0.0, 0.5), V2R(0.5, 0.0) });
+	}
+	return w;
+}
+
+
+std::unique_ptr<Element>
+make_library_element(const ShapeLibrary &library,
+					 const exint &shape,
+					 const short &dir,
+					 bool inherit_prim_attrs,
+					 bool unwrapuvs,
+					 GA_AttributeRefMap &prim_refmap,
+					 GA_Attribute *uvattr,
+					 GA_PrimitiveGroup *elem_grp,
+					 GA_PrimitiveGroup *elem_front_grp,
+					 CoordStore *store)
+{
+	std::unique_ptr<Element> w(new Element(ElementTypes::CUSTOM, dir, uvattr, elem_grp, elem_front_grp, store));
+	w->unwrapuvs = unwrapuvs;
+	w->inherit_prim_attrs = inherit_prim_attrs;
+	w->prim_refmap = prim_refmap;
+	w->library_shape = shape;
+	for (exint i = 0; i < library.num_outlines(shape); i++) {
+		exint start = library.outline_start(shape, i);
+		exint num = library.outline_size(shape, i);
+		// Second direction is the transposed shape, reversed to keep the winding
+		bool hole = library.is_hole(shape, i);
+		if (dir == 0)
+			w->append(library.xs() + start, library.ys() + start, num, false, hole);
+		else
+			w->append(library.ys() + start, library.xs() + start, num, true, hole);
+	}
+	return w;
+}
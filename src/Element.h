@@ -1,65 +1,186 @@
-#pragma once
-#include <UT/UT_Vector2Array.h>
-#include <GA/GA_AttributeRefMap.h>
-#include <GU/GU_Detail.h>
-
-struct BBox2D
-{
-	UT_Vector2R minvec;
-	UT_Vector2R maxvec;
-};
-
-enum class ElementTypes {
-	STRIPE  = 0x0001,
-	STRIPE2 = 0x0002,
-	STRIPE3 = 0x0004,
-	TSHAPE  = 0x0008,
-	RSHAPE  = 0x0010,
-	SQUARE  = 0x0020,
-	TRIANGLE = 0x0030,
-};
-
-
-class SubElem
-{
-public:
-	UT_Vector2RArray coords;
-};
-
-class Element
-{
-public:
-	Element(ElementTypes type, const short &direction, GA_Attribute *uvattr, GA_PrimitiveGroup *elem_grp, GA_PrimitiveGroup *elem_front_grp);
-	~Element();
-	BBox2D bbox();
-	UT_Vector2R pivot();
-	UT_Vector2R bounds_intersection();
-	void append(SubElem elem);
-	void transform(const UT_Vector2R &new_pos, const fpreal &scale, const bool flip);
-	void build(GU_Detail *gdp, const GEO_Primitive *prim, const UT_Vector3 &primN, const fpreal &height);
-
-	bool unwrapuvs;
-	bool inherit_prim_attrs;
-	GA_AttributeRefMap prim_refmap;
-
-private:
-	ElementTypes type;
-	short direction;
-	UT_ValArray<SubElem> subelements;
-	GA_PrimitiveGroup *elem_group;
-	GA_PrimitiveGroup *elem_front_group;
-	GA_Attribute *uvattr;
-	void move_by_vec(const UT_Vector2R &vec);
-	exint num_points();
-
-};
-
-std::unique_ptr<Element> make_element(const ElementTypes &elem_type, 
-									  const short &dir, 
-									  bool inherit_prim_attrs,
-						              bool unwrapuvs,
-									  GA_AttributeRefMap &prim_refmap,
-									  GA_Attribute *uvattr,
-									  GA_PrimitiveGroup *elem_grp,
-									  GA_PrimitiveGroup *elem_front_grp);
-
+#pragma once
+#include <UT/UT_Vector2Array.h>
+#include <UT/UT_SmallArray.h>
+#include <UT/UT_ValArray.h>
+#include <initializer_list>
+#include <functional>
+#include "ShapeLibrary.h"
+#include "Bevel.h"
+#include "UVAtlas.h"
+#include "Layout.h"
+#include <GA/GA_AttributeRefMap.h>
+#include <GU/GU_Detail.h>
+
+struct BBox2D
+{
+	UT_Vector2R minvec;
+	UT_Vector2R maxvec;
+};
+
+enum class ElementTypes {
+	STRIPE  = 0x0001,
+	STRIPE2 = 0x0002,
+	STRIPE3 = 0x0004,
+	TSHAPE  = 0x0008,
+	RSHAPE  = 0x0010,
+	SQUARE  = 0x0020,
+	TRIANGLE = 0x0030,
+	CUSTOM = 0x0040,
+};
+
+enum class ElementLOD {
+	FULL = 0,
+	CAP = 1,
+	CULL = 2,
+};
+
+// Shapes of ElementTypes, library shapes are keyed after them
+const exint NUM_BUILTIN_SHAPES = 7;
+// Prototypes per shape, one for every (direction, flip)
+const exint PROTOTYPE_VARIANTS = 4;
+
+// Outline coordinates of all sub-elements, stored as separate x and y runs.
+// Sub-element i spans [offsets(i), offsets(i + 1)), so the layout passes are
+// flat loops. Inline storage covers every built-in shape without touching the heap.
+// A hole sub-element cuts into the closest preceding solid one.
+typedef UT_SmallArray<fpreal32, 16 * sizeof(fpreal32)> CoordArray;
+
+// Coordinates of elements planned together, one pair of arrays for the whole
+// batch instead of storage per element. Clearing keeps the capacity.
+struct CoordStore
+{
+	UT_Array<fpreal32> xs;
+	UT_Array<fpreal32> ys;
+	void clear() { xs.clear(); ys.clear(); }
+};
+
+// The run of one element inside a store array. Only the last run of a store
+// grows, the others can be rewritten up to the size they had.
+class CoordRun
+{
+public:
+	CoordRun() :values(nullptr), first(0), size(0), reserved(0) {}
+	void bind(UT_Array<fpreal32> *store) { values = store; first = store->entries(); size = 0; reserved = 0; }
+	fpreal32 &operator()(const exint &i) { return (*values)(first + i); }
+	fpreal32 operator()(const exint &i) const { return (*values)(first + i); }
+	fpreal32 *data() { return values->data() + first; }
+	const fpreal32 *data() const { return values->data() + first; }
+	exint entries() const { return size; }
+	void clear() { size = 0; }
+	void append(const fpreal32 &value)
+	{
+		if (size < reserved)
+			(*values)(first + size) = value;
+		else {
+			UT_ASSERT(first + size == values->entries());
+			values->append(value);
+			reserved++;
+		}
+		size++;
+	}
+
+private:
+	UT_Array<fpreal32> *values;
+	exint first;
+	exint size;
+	exint reserved;
+};
+typedef UT_SmallArray<exint, 4 * sizeof(exint)> SubElemOffsets;
+typedef UT_SmallArray<uint8, 4> SubElemFlags;
+
+// Base ring of a built sub-element, used to stitch elements into their host face
+struct BaseRing
+{
+	GA_OffsetArray points;
+	UT_Array<UT_Vector2R> coords; // host parametric
+	bool hole;
+};
+
+class Element
+{
+public:
+	// Coordinates go to store when given, to the element itself otherwise
+	Element(ElementTypes type, const short &direction, GA_Attribute *uvattr, GA_PrimitiveGroup *elem_grp, GA_PrimitiveGroup *elem_front_grp,
+			CoordStore *store = nullptr);
+	~Element();
+	BBox2D bbox();
+	UT_Vector2R pivot();
+	UT_Vector2R bounds_intersection();
+	void append(std::initializer_list<UT_Vector2R> coords);
+	void append(const fpreal32 *x, const fpreal32 *y, const exint &num, const bool reverse = false, const bool hole = false);
+	bool has_holes() const;
+	exint num_subelements() const { return offsets.entries() - 1; }
+	exint subelem_start(const exint &index) const { return offsets(index); }
+	exint subelem_size(const exint &index) const { return offsets(index + 1) - offsets(index); }
+	UT_Vector2R coord(const exint &index) const { return UT_Vector2R(xs(index), ys(index)); }
+	void flip();
+	void transform(const UT_Vector2R &new_pos, const fpreal &scale, const bool flip);
+	void build(GU_Detail *gdp, const GEO_Primitive *prim, const UT_Vector3 &primN, const fpreal &height, const bool side_walls = true,
+			   const UT_IntArray *cap_triangles = nullptr, const BevelProfile *bevel = nullptr, const fpreal &bevel_size = 0.0,
+			   UT_ValArray<GEO_Primitive*> *caps = nullptr);
+	fpreal world_size(const GEO_Primitive *prim, UT_Vector3 &center);
+	bool merge_subelements();
+	void triangulate(UT_IntArray &triangles);
+	void build_prototype(GU_Detail *proto, const UT_IntArray *cap_triangles = nullptr);
+	void instance_xform(const GEO_Primitive *prim, const UT_Vector3 &primN, const fpreal &height, UT_Matrix3D &xform, UT_Vector3D &pos);
+	exint prototype_key() const;
+	ElementTypes get_type() const { return type; }
+	short get_direction() const { return direction; }
+	bool is_flipped() const { return flipped; }
+	exint get_library_shape() const { return library_shape; }
+	// Builds into another detail from now on, its uv attribute and groups
+	void retarget(GA_Attribute *new_uvattr, GA_PrimitiveGroup *elem_grp, GA_PrimitiveGroup *elem_front_grp);
+
+	exint library_shape;
+
+	bool unwrapuvs;
+	bool inherit_prim_attrs;
+	GA_AttributeRefMap prim_refmap;
+	UVAtlas *atlas; // collects wall and cap charts instead of unwrapping
+	GA_RWHandleV3 normal_handle; // vertex N, written when valid
+	GA_RWHandleV3 tangent_handle;
+	UT_Array<BaseRing> *base_rings; // receives the base ring of every sub-element when set
+	bool cap_base;
+
+private:
+	ElementTypes type;
+	short direction;
+	bool flipped;
+	// Affine part of transform(), instances are placed with it
+	hreeble::OutlineXform xform;
+	CoordArray own_xs;
+	CoordArray own_ys;
+	CoordRun xs;
+	CoordRun ys;
+	SubElemOffsets offsets;
+	SubElemFlags hole_flags;
+	GA_PrimitiveGroup *elem_group;
+	GA_PrimitiveGroup *elem_front_group;
+	GA_Attribute *uvattr;
+	// Host position and tangents at a parametric point, linearized over a small step
+	void host_derivs(const GEO_Primitive *prim, const UT_Vector2R &at, UT_Vector3D &center, UT_Vector3D &dpdu, UT_Vector3D &dpdv);
+	exint num_points();
+
+};
+
+std::unique_ptr<Element> make_element(const ElementTypes &elem_type, 
+									  const short &dir, 
+									  bool inherit_prim_attrs,
+						              bool unwrapuvs,
+									  GA_AttributeRefMap &prim_refmap,
+									  GA_Attribute *uvattr,
+									  GA_PrimitiveGroup *elem_grp,
+									  GA_PrimitiveGroup *elem_front_grp,
+									  CoordStore *store = nullptr);
+
+std::unique_ptr<Element> make_library_element(const ShapeLibrary &library,
+											  const exint &shape,
+											  const short &dir,
+											  bool inherit_prim_attrs,
+											  bool unwrapuvs,
+											  GA_AttributeRefMap &prim_refmap,
+											  GA_Attribute *uvattr,
+											  GA_PrimitiveGroup *elem_grp,
+											  GA_PrimitiveGroup *elem_front_grp,
+											  CoordStore *store = nullptr);
+
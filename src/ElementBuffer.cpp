@@ -0,0 +1,151 @@
+#include "ElementBuffer.h"
+#include <GU/GU_PrimPoly.h>
+#include <GEO/GEO_PolyCounts.h>
+#include <GA/GA_AIFCopyData.h>
+#include <GA/GA_SplittableRange.h>
+#include <UT/UT_ParallelUtil.h>
+#include <UT/UT_IntArray.h>
+#include <UT/UT_String.h>
+#include <algorithm>
+
+ElementBuffer::ElementBuffer(const GU_Detail &target, const GA_Attribute *target_uvattr, const GA_Attribute *normal_attr, const GA_Attribute *tangent_attr,
+							 const GA_PrimitiveGroup *elem_grp, const GA_PrimitiveGroup *elem_front_grp, const bool inherit_attribs)
+	:uvattr(nullptr), elem_group(nullptr), elem_front_group(nullptr)
+{
+	// Only what elements write, new target elements get defaults for the rest anyway
+	UT_String pattern;
+	const GA_Attribute *vertex_attrs[] = { target_uvattr, normal_attr, tangent_attr };
+	for (const auto attr : vertex_attrs) {
+		if (attr == nullptr)
+			continue;
+		if (pattern.isstring())
+			pattern += " ";
+		pattern += static_cast<const char*>(attr->getName());
+	}
+	if (pattern.isstring())
+		buffer.cloneMissingAttributes(target, GA_ATTRIB_VERTEX, GA_AttributeFilter::selectByPattern(pattern));
+	if (inherit_attribs)
+		buffer.cloneMissingAttributes(target, GA_ATTRIB_PRIMITIVE, GA_AttributeFilter::selectPublic());
+	if (target_uvattr != nullptr)
+		uvattr = buffer.findAttribute(GA_ATTRIB_VERTEX, target_uvattr->getName());
+	if (normal_attr != nullptr)
+		normal_handle = buffer.findAttribute(GA_ATTRIB_VERTEX, normal_attr->getName());
+	if (tangent_attr != nullptr)
+		tangent_handle = buffer.findAttribute(GA_ATTRIB_VERTEX, tangent_attr->getName());
+	if (elem_grp != nullptr)
+		elem_group = buffer.newPrimitiveGroup(elem_grp->getName());
+	if (elem_front_grp != nullptr)
+		elem_front_group = buffer.newPrimitiveGroup(elem_front_grp->getName());
+
+	// Values come from hosts in the target
+	prim_refmap.bind(buffer, target);
+	if (inherit_attribs) {
+		for (GA_AttributeDict::iterator it = buffer.primitiveAttribs().begin(); !it.atEnd(); ++it) {
+			prim_refmap.appendDest(it.attrib());
+		}
+	}
+}
+
+
+void ElementBuffer::bind(Element &element)
+{
+	element.retarget(uvattr, elem_group, elem_front_group);
+	element.prim_refmap = prim_refmap;
+	element.normal_handle = normal_handle;
+	element.tangent_handle = tangent_handle;
+}
+
+
+void ElementBuffer::splice(GU_Detail *target, const std::vector<std::unique_ptr<ElementBuffer>> &buffers)
+{
+	exint num_buffers = exint(buffers.size());
+	if (num_buffers == 0)
+		return;
+	// Where each buffer starts in the spliced block
+	UT_ExintArray point_starts, vertex_starts, prim_starts;
+	point_starts.append(0);
+	vertex_starts.append(0);
+	prim_starts.append(0);
+	for (const auto &each : buffers) {
+		point_starts.append(point_starts.last() + each->buffer.getNumPoints());
+		vertex_starts.append(vertex_starts.last() + each->buffer.getNumVertices());
+		prim_starts.append(prim_starts.last() + each->buffer.getNumPrimitives());
+	}
+	exint num_points = point_starts.last();
+	exint num_prims = prim_starts.last();
+	if (num_prims == 0)
+		return;
+
+	// Topology as block relative point numbers, every buffer fills its own slice
+	UT_IntArray sizes, point_numbers;
+	sizes.setSize(num_prims);
+	point_numbers.setSize(vertex_starts.last());
+	UTparallelFor(UT_BlockedRange<exint>(0, num_buffers), [&](const UT_BlockedRange<exint> &range) {
+		for (exint b = range.begin(); b != range.end(); ++b) {
+			const GU_Detail &src = buffers[b]->buffer;
+			exint prim = prim_starts(b), vtx = vertex_starts(b);
+			for (GA_Iterator it(src.getPrimitiveRange()); !it.atEnd(); ++it) {
+				const GA_Primitive *src_prim = src.getPrimitive(*it);
+				GA_Size n = src_prim->getVertexCount();
+				sizes(prim++) = int(n);
+				for (GA_Size i = 0; i < n; i++)
+					point_numbers(vtx++) = int(point_starts(b) + src.pointIndex(src_prim->getPointOffset(i)));
+			}
+		}
+	}, 2, 1);
+
+	GA_Offset point_block = target->appendPointBlock(GA_Size(num_points));
+	GEO_PolyCounts poly_counts;
+	for (const auto &n : sizes)
+		poly_counts.append(GA_Size(n));
+	GA_Offset prim_block = GU_PrimPoly::buildBlock(target, point_block, GA_Size(num_points), poly_counts, point_numbers.array());
+	GA_Offset vertex_block = target->getPrimitiveVertexOffset(prim_block, 0);
+
+	// Attribute values page by page, a page may take values from several buffers
+	auto copy_block = [&](const GA_AttributeOwner &owner, const GA_Offset &block, const exint &total, const UT_ExintArray &starts) {
+		UT_Array<const GA_Attribute*> src_attrs;
+		for (GA_AttributeDict::iterator it = buffers[0]->buffer.getAttributeDict(owner).begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it)
+			src_attrs.append(it.attrib());
+		for (const auto src_attr : src_attrs) {
+			GA_Attribute *dst_attr = target->findAttribute(owner, src_attr->getName());
+			const GA_AIFCopyData *copy = dst_attr != nullptr ? dst_attr->getAIFCopyData() : nullptr;
+			if (copy == nullptr)
+				continue;
+			const GA_IndexMap &dst_map = target->getIndexMap(owner);
+			UTparallelFor(GA_SplittableRange(GA_Range(dst_map, block, block + GA_Offset(total))), [&](const GA_SplittableRange &range) {
+				GA_Offset start, end;
+				for (GA_Iterator it(range); it.blockAdvance(start, end); ) {
+					while (start < end) {
+						exint index = start - block;
+						exint b = std::upper_bound(starts.begin(), starts.end(), index) - starts.begin() - 1;
+						GA_Offset run_end = SYSmin(end, block + GA_Offset(starts(b + 1)));
+						const GU_Detail &src = buffers[b]->buffer;
+						const GA_Attribute *attr = src.findAttribute(owner, src_attr->getName());
+						GA_Offset src_start = src.getIndexMap(owner).offsetFromIndex(GA_Index(index - starts(b)));
+						copy->copy(*dst_attr, GA_Range(dst_map, start, run_end),
+								   *attr, GA_Range(src.getIndexMap(owner), src_start, src_start + (run_end - start)));
+						start = run_end;
+					}
+				}
+			});
+		}
+	};
+	copy_block(GA_ATTRIB_POINT, point_block, num_points, point_starts);
+	copy_block(GA_ATTRIB_VERTEX, vertex_block, vertex_starts.last(), vertex_starts);
+	copy_block(GA_ATTRIB_PRIMITIVE, prim_block, num_prims, prim_starts);
+
+	// Group membership is not thread safe, it is only a walk over the grouped prims
+	for (exint b = 0; b < num_buffers; b++) {
+		const ElementBuffer &each = *buffers[b];
+		const GA_PrimitiveGroup *src_groups[] = { each.elem_group, each.elem_front_group };
+		for (const auto src_group : src_groups) {
+			if (src_group == nullptr)
+				continue;
+			GA_PrimitiveGroup *dst_group = target->findPrimitiveGroup(src_group->getName());
+			if (dst_group == nullptr)
+				continue;
+			for (GA_Iterator it(each.buffer.getPrimitiveRange(src_group)); !it.atEnd(); ++it)
+				dst_group->addOffset(prim_block + GA_Offset(prim_starts(b) + each.buffer.primitiveIndex(*it)));
+		}
+	}
+}
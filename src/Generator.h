@@ -0,0 +1,200 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <GA/GA_AttributeRefMap.h>
+#include <GA/GA_Handle.h>
+#include <UT/UT_ValArray.h>
+#include <UT/UT_IntArray.h>
+#include <UT/UT_String.h>
+#include <UT/UT_Interrupt.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Element.h"
+#include "ElementBuffer.h"
+#include "Bevel.h"
+#include "UVAtlas.h"
+
+enum class OutputModes {
+	POLYGONS = 0,
+	PACKED = 1,
+	POINTS = 2,
+	TRIANGLES = 3,
+};
+
+enum class WatertightModes {
+	OFF = 0,
+	STITCH = 1,
+	CAP_BASES = 2,
+};
+
+enum class LODModes {
+	OFF = 0,
+	CAMERA = 1,
+	SIZE = 2,
+};
+
+enum class GeneratorResult {
+	DONE = 0,
+	FAILED = 1,
+	INTERRUPTED = 2,
+};
+
+// Optional int primitive attribute overriding the source face index in seeds,
+// set on partitions so they greeble like the whole input
+const char *const FACE_ID_ATTRIB = "hreeble_face_id";
+
+// Bumped whenever the same parameters generate different geometry, so disk
+// cached results of older builds are not picked up
+const uint GENERATOR_VERSION = 4;
+
+// Top of the Element Density parameter range. Per face densities are clamped
+// to it, or to the parameter when that is set higher.
+const uint MAX_ELEM_DENSITY = 10;
+
+// Built-in shapes selectable through GeneratorParms::shapes, one bit each
+const uint NUM_SELECTABLE_SHAPES = 6;
+
+// Everything one generation run reads, named after the SOP parameters.
+// Defaults match the parameter defaults.
+struct GeneratorParms
+{
+	GeneratorParms();
+	bool operator==(const GeneratorParms &other) const;
+	bool operator!=(const GeneratorParms &other) const { return !(*this == other); }
+	uint64 hash() const;
+
+	uint seed;
+	uint generate_panels;
+	fpreal panel_inset;
+	fpreal panel_height[2];
+	uint elem_density;
+	fpreal elem_scale[2];
+	fpreal elem_height[2];
+	uint shapes; // bit i selects built-in shape i
+	uint convex;
+	uint create_groups;
+	uint unwrap_uvs;
+	uint inherit_attribs;
+	OutputModes output_mode;
+	uint chunked_cook;
+	exint chunk_size;
+	fpreal memory_budget;
+	LODModes lod_mode;
+	UT_Vector3 lod_camera;
+	fpreal lod_cap_size;
+	fpreal lod_cull_size;
+	std::string shape_library;
+	std::string library_shapes;
+	uint cap_triangles;
+	fpreal elem_bevel;
+	fpreal panel_bevel;
+	BevelShapes bevel_shape;
+	int bevel_segments;
+	uint elem_tiers;
+	fpreal tier_falloff;
+	uint pack_uvs;
+	int uv_tile;
+	uint output_normals;
+	WatertightModes watertight;
+	std::string mesh_file;
+};
+
+// Per source face settings and tier 0 elements, planned in parallel before
+// the face is built. Placement only draws random numbers, so it needs no geometry.
+struct FacePlan
+{
+	uint density;
+	fpreal scale;
+	fpreal height;
+	UT_ValArray<uint> shapes;
+	fpreal cost; // rough amount of generated geometry
+	std::vector<std::unique_ptr<Element>> elements; // density per tier 0 host, host after host, outlines in the task store
+	std::vector<fpreal> heights;
+	UT_ValArray<GEO_Primitive*> hosts; // tier 0 hosts, only kept for buffered builds
+};
+
+// Greebles the faces of a detail in place. Shared by the SOP and the
+// command line tool, so it never touches node or session state.
+class Generator
+{
+public:
+	Generator(const bool interruptible = true);
+	GeneratorResult generate(GU_Detail *detail, const GA_PrimitiveGroup *source_group, const GeneratorParms &parms);
+	// Stops a run on another thread, it returns INTERRUPTED
+	void cancel() { cancelled = true; }
+	const UT_String &error() const { return error_msg; }
+	const UT_String &warning() const { return warning_msg; }
+	// Primitive attributes generate() reads from a source face or copies onto what it builds
+	static void face_attribs(const GU_Detail *detail, const GeneratorParms &parms, UT_Array<const GA_Attribute*> &attribs);
+
+private:
+	void split_primitive(GEO_Primitive *prim, UT_ValArray<GEO_Primitive*> &result, const unsigned short dir = 0);
+	void divide(GEO_Primitive *prim, UT_ValArray<GEO_Primitive*> &result);
+	GEO_Primitive* extrude(GEO_Primitive *prim, const fpreal &height, const fpreal &inset, const fpreal &bevel_size = 0.0);
+	void stitch_host(GEO_Primitive *host, const UT_Array<BaseRing> &rings);
+	void destroy_kill_prims();
+	bool was_interrupted(UT_AutoInterrupt *boss, const int &percent);
+	void read_face_attrib(const char *name, const GA_OffsetList &faces, UT_Array<fpreal32> &values);
+	exint chunk_size(const exint &num_source_prims, const uint &element_density, const uint &num_shapes, const uint &generate_panels);
+	ElementLOD element_lod(Element &element, const GEO_Primitive *prim);
+	std::unique_ptr<Element> create_element(const uint &shape, const short &dir, CoordStore *coords = nullptr);
+	std::unique_ptr<Element> place_element(const UT_ValArray<uint> &shapes, const uint &host_seed, const uint &index, const GA_Size &num_vtx,
+										   const fpreal &height_scale, const fpreal &face_scale, fpreal &height, CoordStore *coords = nullptr);
+	exint num_tier0_hosts(const GA_Size &num_vtx) const;
+	void plan_faces(const exint &start, const exint &end, const GA_OffsetList &source_prims, const UT_Array<exint> &face_ids,
+					const UT_ValArray<uint> &selected_shapes);
+	std::unique_ptr<Element> prototype_element(const Element &element);
+	const UT_IntArray* cap_triangles(const Element &element);
+	void instance_element(Element &element, const GEO_Primitive *prim, const UT_Vector3 &primN, const fpreal &height);
+	// False when interrupted, the batch is dropped then
+	bool build_buffered(const exint &num_faces, UT_AutoInterrupt *boss);
+	bool polygon_output() const { return output_mode == OutputModes::POLYGONS || output_mode == OutputModes::TRIANGLES; }
+
+	GU_Detail *gdp;
+	const GeneratorParms *parms;
+	UT_String error_msg;
+	UT_String warning_msg;
+	GA_RWHandleV3 phandle; // point handle
+	GA_Attribute *uvattr; // vertext handle
+	GA_AttributeRefMap prim_refmap;
+	UT_ValArray<GEO_Primitive*> kill_prims;
+	GA_PrimitiveGroup *elements_group;
+	GA_PrimitiveGroup *elements_front_group;
+	uint inherit_attribs;
+	uint unwrap_uvs;
+	uint my_seed; // random state of the current source face
+	OutputModes output_mode;
+	LODModes lod_mode;
+	UT_Vector3 lod_camera;
+	fpreal lod_cap_size;
+	fpreal lod_cull_size;
+	std::shared_ptr<const ShapeLibrary> shape_library;
+	UT_Array<GU_DetailHandle> prototypes;
+	UT_Array<UT_IntArray> triangulations; // cap triangles per prototype
+	bool triangulate_caps;
+	BevelProfile bevel_profile;
+	bool pack_uvs;
+	GA_RWHandleV3 normal_handle; // vertex N of generated faces, invalid when off
+	GA_RWHandleV3 tangent_handle;
+	WatertightModes watertight;
+	GA_AttributeRefMap vertex_refmap;
+	UT_Array<BaseRing> host_rings; // element bases on the current host
+	UT_Array<BBox2D> placed_boxes;
+	UVAtlas uv_atlas;
+	// Optional per source face overrides, empty when the attribute is missing
+	UT_Array<fpreal32> face_densities;
+	UT_Array<fpreal32> face_scales;
+	UT_Array<fpreal32> face_heights;
+	UT_Array<fpreal32> face_masks;
+	std::vector<FacePlan> face_plans;
+	UT_ExintArray plan_tasks; // first face of each planned task, then the batch size
+	std::vector<CoordStore> task_coords; // outlines of the planned elements, one store per task
+	UT_Array<fpreal> shape_costs; // walls of each selected shape
+	GA_RWHandleQ orient_handle;
+	GA_RWHandleV3 scale_handle;
+	GA_RWHandleF height_handle;
+	GA_RWHandleI shape_handle;
+	bool interruptible; // shows the interrupt dialog, off on worker threads
+	std::atomic<bool> cancelled;
+};
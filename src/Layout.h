@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+// Layout math of element outlines and panel faces on plain arrays. Nothing
+// here touches the HDK, fuzz/ builds it on its own and checks it against
+// reference versions.
+namespace hreeble {
+	struct OutlineBounds
+	{
+		float min[2];
+		float max[2];
+	};
+
+	// Affine part of a layout, per axis: final coord = coord * scale + origin
+	struct OutlineXform
+	{
+		double scale[2];
+		double origin[2];
+	};
+
+	// Outlines hold at least one point
+	OutlineBounds outline_bounds(const float *xs, const float *ys, const int64_t num);
+	void outline_pivot(const float *xs, const float *ys, const int64_t num, double *pivot);
+	// Offset moving bounds that cross the unit square back into it, zero when inside
+	void bounds_offset(const float *xs, const float *ys, const int64_t num, double *offset);
+	// Moves the pivot to target, scales around it and pushes the outline back
+	// into the unit square. Still outside, it's fitted in per axis. Every step
+	// is applied to xform too.
+	void place_outline(float *xs, float *ys, const int64_t num, const double *target, const double scale, OutlineXform &xform);
+
+	// Points halving a quad given as num_vtx xyz corners: dir 0 cuts edges 1-2
+	// and 0-3, dir 1 edges 0-1 and 3-2. Anything but a quad isn't split.
+	bool quad_split_points(const float *corners, const int64_t num_vtx, const int dir, float *first, float *second);
+
+	// Cap ring of an extruded panel: xyz corners lifted along n by height and
+	// moved inset towards the lifted center, dirs gets the unit directions to it.
+	// Returns max_size, reduced so bevel rings can't fold over the center.
+	double inset_ring(const float *base, const int64_t num, const float *n, const float *center, const double height,
+					  const double inset, const double max_size, float *top, float *dirs);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <GU/GU_Detail.h>
+#include <UT/UT_String.h>
+#include <SYS/SYS_Types.h>
+
+// Compact indexed triangle mesh for real-time engines, read without Houdini.
+// After the header come positions (3 x fpreal32 per vertex), then normals
+// (3 x fpreal32) and uvs (2 x fpreal32) when flagged, then uint32 triangle
+// indices with counter-clockwise front faces. Everything is little endian.
+struct MeshFileHeader
+{
+	char magic[8];
+	uint32 version;
+	uint32 flags;
+	uint32 num_vertices;
+	uint32 num_indices;
+};
+
+const uint32 MESH_HAS_NORMALS = 0x1;
+const uint32 MESH_HAS_UVS = 0x2;
+
+namespace hreeble {
+	// Writes every polygon of gdp, fanning the ones that are not triangles.
+	// Vertices sharing a point, normal and uv are written once.
+	bool write_mesh(const GU_Detail *gdp, const char *path, UT_String &error);
+}
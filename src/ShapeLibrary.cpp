@@ -0,0 +1,509 @@
+#include "ShapeLibrary.h"
+#include <UT/UT_JSONParser.h>
+#include <UT/UT_JSONValue.h>
+#include <UT/UT_JSONValueArray.h>
+#include <UT/UT_JSONValueMap.h>
+#include <UT/UT_IStream.h>
+#include <UT/UT_Lock.h>
+#include <UT/UT_WorkBuffer.h>
+#include <SYS/SYS_Math.h>
+#include <sys/stat.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+typedef UT_Vector2R V2R;
+
+static const char CACHE_MAGIC[8] = { 'H', 'R', 'S', 'H', 'A', 'P', 'E', '\0' };
+static const uint32 CACHE_VERSION = 2;
+static const char *CACHE_EXT = ".hrsc";
+static const int BEZIER_STEPS = 8;
+
+// Everything after the header is 4 byte aligned, the file can be mapped as is
+struct ShapeCacheHeader
+{
+	char magic[8];
+	uint32 version;
+	uint32 num_shapes;
+	uint32 num_outlines;
+	uint32 num_coords;
+	uint32 names_size;
+	uint32 reserved;
+	int64 source_size;
+	int64 source_mtime;
+};
+
+
+ShapeLibrary::ShapeLibrary()
+{
+	shape_starts.append(0);
+	outline_starts.append(0);
+}
+
+
+exint ShapeLibrary::outline_size(const exint &shape, const exint &outline) const
+{
+	exint index = shape_starts(shape) + outline;
+	return outline_starts(index + 1) - outline_starts(index);
+}
+
+
+std::shared_ptr<const ShapeLibrary> ShapeLibrary::load(const char *path, UT_String &error)
+{
+	// Libraries are shared by every node in the session
+	static UT_Lock lock;
+	static std::map<std::string, std::pair<int64, std::shared_ptr<const ShapeLibrary>>> loaded;
+
+	struct stat source_stat;
+	if (stat(path, &source_stat) != 0) {
+		error.sprintf("Can't open shape library %s", path);
+		return nullptr;
+	}
+	int64 source_size = source_stat.st_size;
+	int64 source_mtime = source_stat.st_mtime;
+
+	UT_AutoLock guard(lock);
+	auto found = loaded.find(path);
+	if (found != loaded.end() && found->second.first == source_mtime)
+		return found->second.second;
+
+	std::shared_ptr<ShapeLibrary> lib(new ShapeLibrary());
+	UT_WorkBuffer cache_path;
+	cache_path.sprintf("%s%s", path, CACHE_EXT);
+	if (!lib->read_cache(cache_path.buffer(), source_size, source_mtime)) {
+		lib.reset(new ShapeLibrary());
+		UT_String ext(UT_String::ALWAYS_DEEP, path);
+		bool ok;
+		if (ext.fileExtension() && !strcmp(ext.fileExtension(), ".svg"))
+			ok = lib->parse_svg(path, error);
+		else
+			ok = lib->parse_json(path, error);
+		if (!ok)
+			return nullptr;
+		if (lib->num_shapes() == 0) {
+			error.sprintf("No shapes found in %s", path);
+			return nullptr;
+		}
+		// Best effort, a read-only library location just means parsing again next session
+		lib->write_cache(cache_path.buffer(), source_size, source_mtime);
+	}
+	loaded[path] = std::make_pair(source_mtime, lib);
+	return lib;
+}
+
+
+static bool inside(const V2R &pt, const UT_Vector2RArray &outline)
+{
+	bool result = false;
+	exint n = outline.entries();
+	for (exint i = 0, j = n - 1; i < n; j = i++) {
+		const V2R &a = outline(i), &b = outline(j);
+		if ((a.y() > pt.y()) != (b.y() > pt.y())
+			&& pt.x() < (b.x() - a.x()) * (pt.y() - a.y()) / (b.y() - a.y()) + a.x())
+			result = !result;
+	}
+	return result;
+}
+
+
+void ShapeLibrary::add_shape(const char *shape_name, UT_Array<UT_Vector2RArray> &outlines)
+{
+	// Drop closing duplicates and degenerate outlines
+	for (exint i = outlines.entries() - 1; i >= 0; i--) {
+		UT_Vector2RArray &outline = outlines(i);
+		if (outline.entries() > 1 && (outline.last() - outline(0)).length2() < 1e-12)
+			outline.removeLast();
+		if (outline.entries() < 3)
+			outlines.removeIndex(i);
+	}
+	if (outlines.entries() == 0)
+		return;
+
+	V2R minvec = outlines(0)(0), maxvec = outlines(0)(0);
+	for (const auto &outline : outlines) {
+		for (const auto &pt : outline) {
+			minvec = V2R(SYSmin(minvec.x(), pt.x()), SYSmin(minvec.y(), pt.y()));
+			maxvec = V2R(SYSmax(maxvec.x(), pt.x()), SYSmax(maxvec.y(), pt.y()));
+		}
+	}
+	// Uniform fit keeps the drawn proportions
+	fpreal extent = SYSmax(maxvec.x() - minvec.x(), maxvec.y() - minvec.y());
+	if (extent <= 0.0)
+		return;
+
+	// Nesting depth decides solids and holes (even-odd)
+	UT_IntArray depth;
+	for (exint i = 0; i < outlines.entries(); i++) {
+		int count = 0;
+		for (exint j = 0; j < outlines.entries(); j++) {
+			if (j != i && inside(outlines(i)(0), outlines(j)))
+				count++;
+		}
+		depth.append(count);
+	}
+	for (exint i = 0; i < outlines.entries(); i++) {
+		UT_Vector2RArray &outline = outlines(i);
+		// Built-in shapes wind clockwise, match them so walls face outwards. Holes wind the other way.
+		fpreal area = 0.0;
+		for (exint k = 0; k < outline.entries(); k++) {
+			const V2R &p0 = outline(k);
+			const V2R &p1 = outline((k + 1) % outline.entries());
+			area += p0.x() * p1.y() - p1.x() * p0.y();
+		}
+		if ((area > 0.0) != (depth(i) % 2 == 1))
+			outline.reverse();
+	}
+	// Solid outlines each followed by their holes
+	auto append_outline = [&](const UT_Vector2RArray &outline, const bool hole) {
+		for (const auto &pt : outline) {
+			coord_xs.append((pt.x() - minvec.x()) / extent);
+			coord_ys.append((pt.y() - minvec.y()) / extent);
+		}
+		outline_starts.append(coord_xs.entries());
+		outline_flags.append(hole ? 1 : 0);
+	};
+	for (exint i = 0; i < outlines.entries(); i++) {
+		if (depth(i) % 2 == 1)
+			continue;
+		append_outline(outlines(i), false);
+		for (exint j = 0; j < outlines.entries(); j++) {
+			if (depth(j) == depth(i) + 1 && inside(outlines(j)(0), outlines(i)))
+				append_outline(outlines(j), true);
+		}
+	}
+	shape_starts.append(outline_starts.entries() - 1);
+	name_starts.append(names.entries());
+	for (const char *c = shape_name; *c; c++)
+		names.append(*c);
+	names.append('\0');
+}
+
+
+static fpreal json_number(const UT_JSONValue *value)
+{
+	if (value->getType() == UT_JSONValue::JSON_INT)
+		return value->getI();
+	return value->getF();
+}
+
+
+bool ShapeLibrary::parse_json(const char *path, UT_String &error)
+{
+	// { "shapes": [ { "name": "vent", "outlines": [ [[x, y], ...], ... ] }, ... ] }
+	UT_IFStream is(path, UT_ISTREAM_ASCII);
+	UT_JSONParser parser;
+	UT_JSONValue root;
+	if (!root.parseValue(parser, &is) || !root.getMap()) {
+		error.sprintf("Failed to parse shape library %s", path);
+		return false;
+	}
+	const UT_JSONValue *shapes_value = root.getMap()->get("shapes");
+	const UT_JSONValueArray *shapes = shapes_value ? shapes_value->getArray() : nullptr;
+	if (!shapes) {
+		error.sprintf("Shape library %s has no \"shapes\" array", path);
+		return false;
+	}
+	for (exint s = 0; s < shapes->entries(); s++) {
+		const UT_JSONValueMap *shape = shapes->get(s)->getMap();
+		if (!shape)
+			continue;
+		const UT_JSONValue *name_value = shape->get("name");
+		const UT_JSONValue *outlines_value = shape->get("outlines");
+		if (!outlines_value || !outlines_value->getArray())
+			continue;
+		UT_WorkBuffer shape_name;
+		if (name_value && name_value->getS())
+			shape_name.strcpy(name_value->getS());
+		else
+			shape_name.sprintf("shape%d", int(s));
+
+		UT_Array<UT_Vector2RArray> outlines;
+		const UT_JSONValueArray *outlines_array = outlines_value->getArray();
+		for (exint o = 0; o < outlines_array->entries(); o++) {
+			const UT_JSONValueArray *points = outlines_array->get(o)->getArray();
+			if (!points)
+				continue;
+			UT_Vector2RArray &outline = outlines(outlines.append());
+			for (exint p = 0; p < points->entries(); p++) {
+				const UT_JSONValueArray *xy = points->get(p)->getArray();
+				if (xy && xy->entries() >= 2)
+					outline.append(V2R(json_number(xy->get(0)), json_number(xy->get(1))));
+			}
+		}
+		add_shape(shape_name.buffer(), outlines);
+	}
+	return true;
+}
+
+
+static bool read_attribute(const std::string &tag, const char *attr, std::string &value)
+{
+	std::string key = std::string(" ") + attr + "=";
+	size_t pos = tag.find(key);
+	if (pos == std::string::npos)
+		return false;
+	pos += key.size();
+	if (pos >= tag.size() || (tag[pos] != '"' && tag[pos] != '\''))
+		return false;
+	size_t end = tag.find(tag[pos], pos + 1);
+	if (end == std::string::npos)
+		return false;
+	value = tag.substr(pos + 1, end - pos - 1);
+	return true;
+}
+
+
+static bool parse_path_data(const char *data, UT_Array<UT_Vector2RArray> &outlines)
+{
+	// Straight segments plus flattened quadratic and cubic beziers. Arcs are not supported.
+	const char *p = data;
+	V2R cur(0.0, 0.0), start(0.0, 0.0);
+	char cmd = 0;
+	auto skip = [&p]() { while (*p && (isspace(*p) || *p == ',')) p++; };
+	auto number = [&p, &skip](fpreal &val) {
+		skip();
+		char *end;
+		val = strtod(p, &end);
+		if (end == p)
+			return false;
+		p = end;
+		return true;
+	};
+	auto line_to = [&outlines, &cur](const V2R &pt) {
+		if (outlines.entries() == 0)
+			outlines.append();
+		outlines.last().append(pt);
+		cur = pt;
+	};
+
+	while (true) {
+		skip();
+		if (!*p)
+			break;
+		if (isalpha(*p))
+			cmd = *p++;
+		bool rel = islower(cmd) != 0;
+		V2R base = rel ? cur : V2R(0.0, 0.0);
+		fpreal x, y, x1, y1, x2, y2;
+		switch (toupper(cmd))
+		{
+		case 'M':
+			if (!number(x) || !number(y))
+				return false;
+			outlines.append();
+			line_to(base + V2R(x, y));
+			start = cur;
+			// Following pairs are implicit line-tos
+			cmd = rel ? 'l' : 'L';
+			break;
+		case 'L':
+			if (!number(x) || !number(y))
+				return false;
+			line_to(base + V2R(x, y));
+			break;
+		case 'H':
+			if (!number(x))
+				return false;
+			line_to(V2R(rel ? cur.x() + x : x, cur.y()));
+			break;
+		case 'V':
+			if (!number(y))
+				return false;
+			line_to(V2R(cur.x(), rel ? cur.y() + y : y));
+			break;
+		case 'Q':
+		{
+			if (!number(x1) || !number(y1) || !number(x) || !number(y))
+				return false;
+			V2R p0 = cur, c1 = base + V2R(x1, y1), p1 = base + V2R(x, y);
+			for (int i = 1; i <= BEZIER_STEPS; i++) {
+				fpreal t = fpreal(i) / BEZIER_STEPS, it = 1.0 - t;
+				line_to(p0 * (it * it) + c1 * (2.0 * it * t) + p1 * (t * t));
+			}
+			break;
+		}
+		case 'C':
+		{
+			if (!number(x1) || !number(y1) || !number(x2) || !number(y2) || !number(x) || !number(y))
+				return false;
+			V2R p0 = cur, c1 = base + V2R(x1, y1), c2 = base + V2R(x2, y2), p1 = base + V2R(x, y);
+			for (int i = 1; i <= BEZIER_STEPS; i++) {
+				fpreal t = fpreal(i) / BEZIER_STEPS, it = 1.0 - t;
+				line_to(p0 * (it * it * it) + c1 * (3.0 * it * it * t) + c2 * (3.0 * it * t * t) + p1 * (t * t * t));
+			}
+			break;
+		}
+		case 'Z':
+			cur = start;
+			cmd = 0;
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool ShapeLibrary::parse_svg(const char *path, UT_String &error)
+{
+	// Every <path>, <polygon> and <rect> is one shape named by its id, subpaths are outlines.
+	// SVG y points down, flip it so shapes read the same as in the editor.
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		error.sprintf("Can't open shape library %s", path);
+		return false;
+	}
+	std::string text;
+	char chunk[65536];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		text.append(chunk, read);
+	fclose(file);
+
+	size_t pos = 0;
+	int index = 0;
+	while ((pos = text.find('<', pos)) != std::string::npos) {
+		size_t end = text.find('>', pos);
+		if (end == std::string::npos)
+			break;
+		std::string tag = text.substr(pos, end - pos);
+		pos = end;
+		// Normalize whitespace so attribute lookups can rely on a leading space
+		for (auto &c : tag) {
+			if (isspace(c))
+				c = ' ';
+		}
+
+		UT_Array<UT_Vector2RArray> outlines;
+		std::string value;
+		if (tag.compare(0, 5, "<path") == 0 && read_attribute(tag, "d", value)) {
+			if (!parse_path_data(value.c_str(), outlines)) {
+				error.sprintf("Unsupported path data in %s", path);
+				return false;
+			}
+		}
+		else if (tag.compare(0, 8, "<polygon") == 0 && read_attribute(tag, "points", value)) {
+			UT_WorkBuffer data;
+			data.sprintf("M %s Z", value.c_str());
+			if (!parse_path_data(data.buffer(), outlines)) {
+				error.sprintf("Invalid polygon points in %s", path);
+				return false;
+			}
+		}
+		else if (tag.compare(0, 5, "<rect") == 0) {
+			std::string x, y, w, h;
+			if (!read_attribute(tag, "width", w) || !read_attribute(tag, "height", h))
+				continue;
+			fpreal rx = read_attribute(tag, "x", x) ? atof(x.c_str()) : 0.0;
+			fpreal ry = read_attribute(tag, "y", y) ? atof(y.c_str()) : 0.0;
+			fpreal rw = atof(w.c_str()), rh = atof(h.c_str());
+			UT_Vector2RArray &outline = outlines(outlines.append());
+			outline.append(V2R(rx, ry));
+			outline.append(V2R(rx + rw, ry));
+			outline.append(V2R(rx + rw, ry + rh));
+			outline.append(V2R(rx, ry + rh));
+		}
+		else
+			continue;
+
+		for (auto &outline : outlines) {
+			for (auto &pt : outline) {
+				pt.y() = -pt.y();
+			}
+		}
+		std::string shape_name;
+		if (!read_attribute(tag, "id", shape_name)) {
+			UT_WorkBuffer buf;
+			buf.sprintf("shape%d", index);
+			shape_name = buf.buffer();
+		}
+		add_shape(shape_name.c_str(), outlines);
+		index++;
+	}
+	return true;
+}
+
+
+bool ShapeLibrary::read_cache(const char *path, const int64 &source_size, const int64 &source_mtime)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+	struct stat cache_stat;
+	ShapeCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	bool ok = fstat(fileno(file), &cache_stat) == 0
+		&& fread(&header, sizeof(header), 1, file) == 1
+		&& !memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+		&& header.version == CACHE_VERSION
+		&& header.source_size == source_size
+		&& header.source_mtime == source_mtime;
+	// The header counts have to add up to the file, a stale or corrupt cache
+	// must not size the arrays. Sums are 64 bit, no count can wrap them.
+	uint64 payload = (uint64(header.num_shapes) * 2 + 1 + uint64(header.num_outlines) * 2 + 1) * sizeof(uint32)
+		+ uint64(header.num_coords) * 2 * sizeof(fpreal32) + header.names_size;
+	ok = ok && header.num_shapes != 0 && header.names_size != 0
+		&& uint64(cache_stat.st_size) == sizeof(header) + payload;
+	if (ok) {
+		shape_starts.setSizeNoInit(exint(header.num_shapes) + 1);
+		outline_starts.setSizeNoInit(exint(header.num_outlines) + 1);
+		outline_flags.setSizeNoInit(header.num_outlines);
+		coord_xs.setSizeNoInit(header.num_coords);
+		coord_ys.setSizeNoInit(header.num_coords);
+		name_starts.setSizeNoInit(header.num_shapes);
+		names.setSizeNoInit(header.names_size);
+		ok = fread(shape_starts.data(), sizeof(uint32), shape_starts.entries(), file) == size_t(shape_starts.entries())
+			&& fread(outline_starts.data(), sizeof(uint32), outline_starts.entries(), file) == size_t(outline_starts.entries())
+			&& fread(outline_flags.data(), sizeof(uint32), outline_flags.entries(), file) == size_t(outline_flags.entries())
+			&& fread(coord_xs.data(), sizeof(fpreal32), coord_xs.entries(), file) == size_t(coord_xs.entries())
+			&& fread(coord_ys.data(), sizeof(fpreal32), coord_ys.entries(), file) == size_t(coord_ys.entries())
+			&& fread(name_starts.data(), sizeof(uint32), name_starts.entries(), file) == size_t(name_starts.entries())
+			&& fread(names.data(), 1, names.entries(), file) == size_t(names.entries());
+	}
+	fclose(file);
+	// Offsets are indexed unchecked later, hold them to what add_shape writes:
+	// shapes start with a solid outline, outlines have three points or more
+	ok = ok && shape_starts(0) == 0 && shape_starts.last() == header.num_outlines
+		&& outline_starts(0) == 0 && outline_starts.last() == header.num_coords && names.last() == '\0';
+	for (exint s = 0; ok && s < exint(header.num_shapes); s++)
+		ok = shape_starts(s) < shape_starts(s + 1) && shape_starts(s) < header.num_outlines && outline_flags(shape_starts(s)) == 0 && name_starts(s) < header.names_size;
+	for (exint o = 0; ok && o < exint(header.num_outlines); o++)
+		ok = outline_starts(o + 1) >= uint64(outline_starts(o)) + 3 && outline_starts(o + 1) <= header.num_coords && outline_flags(o) <= 1;
+	for (exint i = 0; ok && i < exint(header.num_coords); i++)
+		ok = SYSisFinite(coord_xs(i)) && SYSisFinite(coord_ys(i));
+	return ok;
+}
+
+
+bool ShapeLibrary::write_cache(const char *path, const int64 &source_size, const int64 &source_mtime) const
+{
+	FILE *file = fopen(path, "wb");
+	if (!file)
+		return false;
+	ShapeCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.num_shapes = num_shapes();
+	header.num_outlines = outline_starts.entries() - 1;
+	header.num_coords = coord_xs.entries();
+	header.names_size = names.entries();
+	header.source_size = source_size;
+	header.source_mtime = source_mtime;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(shape_starts.data(), sizeof(uint32), shape_starts.entries(), file) == size_t(shape_starts.entries())
+		&& fwrite(outline_starts.data(), sizeof(uint32), outline_starts.entries(), file) == size_t(outline_starts.entries())
+		&& fwrite(outline_flags.data(), sizeof(uint32), outline_flags.entries(), file) == size_t(outline_flags.entries())
+		&& fwrite(coord_xs.data(), sizeof(fpreal32), coord_xs.entries(), file) == size_t(coord_xs.entries())
+		&& fwrite(coord_ys.data(), sizeof(fpreal32), coord_ys.entries(), file) == size_t(coord_ys.entries())
+		&& fwrite(name_starts.data(), sizeof(uint32), name_starts.entries(), file) == size_t(name_starts.entries())
+		&& fwrite(names.data(), 1, names.entries(), file) == size_t(names.entries());
+	fclose(file);
+	if (!ok)
+		remove(path);
+	return ok;
+}
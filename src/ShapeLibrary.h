@@ -0,0 +1,41 @@
+#pragma once
+#include <UT/UT_Array.h>
+#include <UT/UT_String.h>
+#include <UT/UT_Vector2Array.h>
+#include <SYS/SYS_Types.h>
+#include <memory>
+
+// Studio shapes loaded from SVG paths or JSON outlines and normalized into the
+// unit square used by Element::transform. Outlines nested an odd number of times
+// are holes. A parsed library is compiled into a
+// flat binary cache next to its source, later loads read it back block by block.
+class ShapeLibrary
+{
+public:
+	ShapeLibrary();
+	static std::shared_ptr<const ShapeLibrary> load(const char *path, UT_String &error);
+
+	exint num_shapes() const { return shape_starts.entries() - 1; }
+	const char *name(const exint &shape) const { return &names(name_starts(shape)); }
+	exint num_outlines(const exint &shape) const { return shape_starts(shape + 1) - shape_starts(shape); }
+	exint outline_start(const exint &shape, const exint &outline) const { return outline_starts(shape_starts(shape) + outline); }
+	exint outline_size(const exint &shape, const exint &outline) const;
+	bool is_hole(const exint &shape, const exint &outline) const { return outline_flags(shape_starts(shape) + outline) != 0; }
+	const fpreal32 *xs() const { return coord_xs.data(); }
+	const fpreal32 *ys() const { return coord_ys.data(); }
+
+private:
+	bool parse_json(const char *path, UT_String &error);
+	bool parse_svg(const char *path, UT_String &error);
+	void add_shape(const char *shape_name, UT_Array<UT_Vector2RArray> &outlines);
+	bool read_cache(const char *path, const int64 &source_size, const int64 &source_mtime);
+	bool write_cache(const char *path, const int64 &source_size, const int64 &source_mtime) const;
+
+	UT_Array<uint32> shape_starts; // first outline of every shape, plus end
+	UT_Array<uint32> outline_starts; // first coord of every outline, plus end
+	UT_Array<uint32> outline_flags; // 1 for holes, which follow the outline they cut into
+	UT_Array<fpreal32> coord_xs;
+	UT_Array<fpreal32> coord_ys;
+	UT_Array<uint32> name_starts;
+	UT_Array<char> names; // null separated
+};
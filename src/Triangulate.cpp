@@ -0,0 +1,214 @@
+#include "Triangulate.h"
+#include <UT/UT_Swap.h>
+#include <SYS/SYS_Math.h>
+#include <algorithm>
+
+namespace {
+	struct Coords
+	{
+		const fpreal32 *xs;
+		const fpreal32 *ys;
+
+		fpreal64 cross(const int &a, const int &b, const int &c) const
+		{
+			return (fpreal64(xs[b]) - xs[a]) * (fpreal64(ys[c]) - ys[a]) - (fpreal64(ys[b]) - ys[a]) * (fpreal64(xs[c]) - xs[a]);
+		}
+
+		bool same(const int &a, const int &b) const
+		{
+			return xs[a] == xs[b] && ys[a] == ys[b];
+		}
+
+		fpreal64 area(const UT_IntArray &ring) const
+		{
+			fpreal64 sum = 0.0;
+			exint n = ring.entries();
+			for (exint i = 0; i < n; i++) {
+				int a = ring(i), b = ring((i + 1) % n);
+				sum += fpreal64(xs[a]) * ys[b] - fpreal64(xs[b]) * ys[a];
+			}
+			return sum * 0.5;
+		}
+	};
+
+	inline fpreal64 cross2(const fpreal64 &ax, const fpreal64 &ay, const fpreal64 &bx, const fpreal64 &by, const fpreal64 &cx, const fpreal64 &cy)
+	{
+		return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+	}
+
+	// Inclusive test against a counter-clockwise triangle
+	inline bool in_triangle(const fpreal64 &px, const fpreal64 &py,
+							const fpreal64 &ax, const fpreal64 &ay,
+							const fpreal64 &bx, const fpreal64 &by,
+							const fpreal64 &cx, const fpreal64 &cy)
+	{
+		return cross2(ax, ay, bx, by, px, py) >= 0.0
+			&& cross2(bx, by, cx, cy, px, py) >= 0.0
+			&& cross2(cx, cy, ax, ay, px, py) >= 0.0;
+	}
+
+	// Splices a clockwise hole into the counter-clockwise outer ring through a
+	// mutually visible vertex pair (Eberly, "Triangulation by Ear Clipping").
+	void bridge_hole(const Coords &c, UT_IntArray &outer, const UT_IntArray &hole)
+	{
+		exint hm = 0;
+		for (exint i = 1; i < hole.entries(); i++) {
+			if (c.xs[hole(i)] > c.xs[hole(hm)])
+				hm = i;
+		}
+		int m = hole(hm);
+		fpreal64 mx = c.xs[m], my = c.ys[m];
+
+		// Closest outer edge hit by a ray from M towards +x
+		exint n = outer.entries();
+		exint best = -1;
+		fpreal64 hit_x = SYS_FP64_MAX;
+		for (exint i = 0; i < n; i++) {
+			int a = outer(i), b = outer((i + 1) % n);
+			fpreal64 ay = c.ys[a], by = c.ys[b];
+			if ((ay > my) == (by > my))
+				continue;
+			fpreal64 x = c.xs[a] + (my - ay) / (by - ay) * (fpreal64(c.xs[b]) - c.xs[a]);
+			if (x < mx || x >= hit_x)
+				continue;
+			hit_x = x;
+			best = c.xs[a] > c.xs[b] ? i : (i + 1) % n;
+		}
+
+		if (best < 0) {
+			// Hole touches or leaves the boundary, fall back to the nearest vertex
+			fpreal64 best_dist = SYS_FP64_MAX;
+			for (exint i = 0; i < n; i++) {
+				fpreal64 dx = c.xs[outer(i)] - mx, dy = c.ys[outer(i)] - my;
+				if (dx * dx + dy * dy < best_dist) {
+					best_dist = dx * dx + dy * dy;
+					best = i;
+				}
+			}
+		}
+		else {
+			// Reflex vertices inside (M, I, P) block the bridge, take the one closest in angle to the ray
+			int p = outer(best);
+			fpreal64 px = c.xs[p], py = c.ys[p];
+			bool ccw = cross2(mx, my, hit_x, my, px, py) >= 0.0;
+			fpreal64 best_tan = SYS_FP64_MAX;
+			for (exint i = 0; i < n; i++) {
+				int v = outer(i);
+				if (v == p || c.same(v, p))
+					continue;
+				if (c.cross(outer((i + n - 1) % n), v, outer((i + 1) % n)) >= 0.0)
+					continue;
+				fpreal64 vx = c.xs[v], vy = c.ys[v];
+				bool inside = ccw ? in_triangle(vx, vy, mx, my, hit_x, my, px, py)
+								  : in_triangle(vx, vy, mx, my, px, py, hit_x, my);
+				if (!inside || vx <= mx)
+					continue;
+				fpreal64 tan = SYSabs(vy - my) / (vx - mx);
+				if (tan < best_tan) {
+					best_tan = tan;
+					best = i;
+				}
+			}
+		}
+
+		UT_IntArray merged;
+		merged.setCapacity(n + hole.entries() + 2);
+		for (exint i = 0; i <= best; i++)
+			merged.append(outer(i));
+		for (exint i = 0; i <= hole.entries(); i++)
+			merged.append(hole((hm + i) % hole.entries()));
+		merged.append(outer(best));
+		for (exint i = best + 1; i < n; i++)
+			merged.append(outer(i));
+		outer = merged;
+	}
+
+	void ear_clip(const Coords &c, UT_IntArray &poly, UT_IntArray &triangles)
+	{
+		while (poly.entries() > 3) {
+			exint n = poly.entries();
+			exint ear = -1;
+			for (exint i = 0; i < n && ear < 0; i++) {
+				int a = poly((i + n - 1) % n), b = poly(i), d = poly((i + 1) % n);
+				if (c.cross(a, b, d) <= 0.0)
+					continue;
+				bool blocked = false;
+				for (exint j = 0; j < n && !blocked; j++) {
+					int p = poly(j);
+					if (c.same(p, a) || c.same(p, b) || c.same(p, d))
+						continue;
+					blocked = in_triangle(c.xs[p], c.ys[p], c.xs[a], c.ys[a], c.xs[b], c.ys[b], c.xs[d], c.ys[d]);
+				}
+				if (!blocked)
+					ear = i;
+			}
+			bool emit = true;
+			if (ear < 0) {
+				// Only degenerate corners left, drop the flattest one
+				fpreal64 flattest = SYS_FP64_MAX;
+				for (exint i = 0; i < n; i++) {
+					fpreal64 area = SYSabs(c.cross(poly((i + n - 1) % n), poly(i), poly((i + 1) % n)));
+					if (area < flattest) {
+						flattest = area;
+						ear = i;
+					}
+				}
+				emit = c.cross(poly((ear + n - 1) % n), poly(ear), poly((ear + 1) % n)) > 0.0;
+			}
+			if (emit) {
+				triangles.append(poly((ear + n - 1) % n));
+				triangles.append(poly(ear));
+				triangles.append(poly((ear + 1) % n));
+			}
+			poly.removeIndex(ear);
+		}
+		if (poly.entries() == 3 && c.cross(poly(0), poly(1), poly(2)) > 0.0) {
+			triangles.append(poly(0));
+			triangles.append(poly(1));
+			triangles.append(poly(2));
+		}
+	}
+}
+
+
+bool hreeble::triangulate(const fpreal32 *xs, const fpreal32 *ys, const UT_Array<UT_IntArray> &outlines, UT_IntArray &triangles)
+{
+	if (outlines.entries() == 0 || outlines(0).entries() < 3)
+		return false;
+	Coords c = { xs, ys };
+
+	// Work counter-clockwise, flip the result back at the end if needed
+	UT_IntArray poly(outlines(0));
+	bool reversed = c.area(poly) < 0.0;
+	if (reversed)
+		poly.reverse();
+
+	UT_Array<UT_IntArray> holes;
+	UT_Array<fpreal32> max_x;
+	for (exint i = 1; i < outlines.entries(); i++) {
+		if (outlines(i).entries() < 3)
+			continue;
+		UT_IntArray &hole = holes(holes.append(outlines(i)));
+		if (c.area(hole) > 0.0)
+			hole.reverse();
+		fpreal32 x = xs[hole(0)];
+		for (const auto &idx : hole)
+			x = SYSmax(x, xs[idx]);
+		max_x.append(x);
+	}
+	// Rightmost holes first, so later bridges can land on earlier holes
+	UT_IntArray order;
+	for (exint i = 0; i < holes.entries(); i++)
+		order.append(i);
+	std::sort(order.begin(), order.end(), [&max_x](const int &a, const int &b) { return max_x(a) > max_x(b); });
+	for (const auto &i : order)
+		bridge_hole(c, poly, holes(i));
+
+	exint first = triangles.entries();
+	ear_clip(c, poly, triangles);
+	if (reversed) {
+		for (exint i = first; i < triangles.entries(); i += 3)
+			UTswap(triangles(i + 1), triangles(i + 2));
+	}
+	return triangles.entries() > first;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <UT/UT_Array.h>
+#include <SYS/SYS_Types.h>
+
+namespace hreeble {
+	// Ear clipping triangulation of a polygon with optional holes.
+	// outlines(0) is the outer boundary, the rest are holes inside it, all as
+	// indices into xs/ys. Triangles are appended to triangles as index triples
+	// and keep the winding of the outer boundary.
+	bool triangulate(const fpreal32 *xs, const fpreal32 *ys, const UT_Array<UT_IntArray> &outlines, UT_IntArray &triangles);
+}
@@ -0,0 +1,116 @@
+#include "UVAtlas.h"
+#include <SYS/SYS_Math.h>
+#include <algorithm>
+
+// Part of the tile the first packing attempt aims to cover
+static const fpreal FILL_RATIO = 0.8;
+static const int MAX_ATTEMPTS = 64;
+// Most of the tile the gaps around charts may take, padding shrinks to stay below it
+static const fpreal PADDING_SHARE = 0.05;
+
+UVAtlas::UVAtlas()
+	:num_charts(0)
+{
+}
+
+
+void UVAtlas::clear()
+{
+	num_charts = 0;
+	charts.clear();
+	vertices.clear();
+	us.clear();
+	vs.clear();
+}
+
+
+void UVAtlas::add(const int &chart, const GA_Offset &vertex, const fpreal32 &u, const fpreal32 &v)
+{
+	charts.append(chart);
+	vertices.append(vertex);
+	us.append(u);
+	vs.append(v);
+}
+
+
+bool UVAtlas::place(const UT_IntArray &order, const fpreal &scale, const fpreal &padding)
+{
+	// Shelves fill left to right, a chart that doesn't fit opens a new shelf on top
+	fpreal x = padding, y = padding, shelf = 0.0;
+	for (const auto &c : order) {
+		fpreal w = (max_u(c) - min_u(c)) * scale;
+		fpreal h = (max_v(c) - min_v(c)) * scale;
+		if (w + 2.0 * padding > 1.0)
+			return false;
+		if (x + w + padding > 1.0) {
+			x = padding;
+			y += shelf + padding;
+			shelf = 0.0;
+		}
+		if (y + h + padding > 1.0)
+			return false;
+		pos_u(c) = x;
+		pos_v(c) = y;
+		x += w + padding;
+		shelf = SYSmax(shelf, h);
+	}
+	return true;
+}
+
+
+bool UVAtlas::pack(const GA_RWHandleV3D &uvh, const int &tile, const fpreal &padding)
+{
+	if (num_charts == 0 || !uvh.isValid())
+		return false;
+	min_u.setSize(num_charts);
+	min_v.setSize(num_charts);
+	max_u.setSize(num_charts);
+	max_v.setSize(num_charts);
+	pos_u.setSize(num_charts);
+	pos_v.setSize(num_charts);
+	for (int c = 0; c < num_charts; c++) {
+		min_u(c) = min_v(c) = SYS_FP32_MAX;
+		max_u(c) = max_v(c) = -SYS_FP32_MAX;
+	}
+	for (exint i = 0; i < vertices.entries(); i++) {
+		int c = charts(i);
+		min_u(c) = SYSmin(min_u(c), us(i));
+		min_v(c) = SYSmin(min_v(c), vs(i));
+		max_u(c) = SYSmax(max_u(c), us(i));
+		max_v(c) = SYSmax(max_v(c), vs(i));
+	}
+	fpreal total_area = 0.0;
+	UT_IntArray order;
+	order.setCapacity(num_charts);
+	for (int c = 0; c < num_charts; c++) {
+		if (min_u(c) > max_u(c))
+			continue;
+		total_area += fpreal(max_u(c) - min_u(c)) * (max_v(c) - min_v(c));
+		order.append(c);
+	}
+	if (total_area <= 0.0)
+		return false;
+	// Tallest first keeps shelves tight
+	std::sort(order.begin(), order.end(), [this](const int &a, const int &b) {
+		fpreal32 ha = max_v(a) - min_v(a), hb = max_v(b) - min_v(b);
+		return ha != hb ? ha > hb : a < b;
+	});
+
+	// Every chart takes at least a padding square, however small it's scaled
+	fpreal gap = SYSmin(padding, SYSsqrt(PADDING_SHARE / order.entries()));
+	fpreal scale = SYSsqrt(FILL_RATIO / total_area);
+	bool packed = false;
+	for (int attempt = 0; attempt < MAX_ATTEMPTS && !packed; attempt++) {
+		packed = place(order, scale, gap);
+		if (!packed)
+			scale *= 0.9;
+	}
+	if (!packed)
+		return false;
+	for (exint i = 0; i < vertices.entries(); i++) {
+		int c = charts(i);
+		uvh.set(vertices(i), UT_Vector3D(tile + pos_u(c) + (us(i) - min_u(c)) * scale,
+										 pos_v(c) + (vs(i) - min_v(c)) * scale, 0.0));
+	}
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <GEO/GEO_Primitive.h>
+#include <GA/GA_Handle.h>
+#include <UT/UT_Array.h>
+#include <UT/UT_FloatArray.h>
+#include <UT/UT_Vector3.h>
+
+// UV layout of one host face, computed once and shared by every wall, bevel
+// strip and cap generated on it. Interior uvs come from the host interpolation
+// weights and wall offsets from analytic areas, so nothing is read back from
+// vertices that were just written.
+class UVFrame
+{
+public:
+	UVFrame();
+	bool init(const GEO_Primitive *prim, const GA_Attribute *uvattr);
+	UT_Vector3R uv_at(const fpreal &u, const fpreal &v) const;
+	const UT_Vector3R &host_uv(const GA_Size &vertex) const { return uvs(vertex); }
+	const UT_Vector3R &center() const { return island_center; }
+	fpreal ratio() const { return area_ratio; }
+	// Shift away from the island center giving a wall on the uv edge (uv0, uv1)
+	// the uv area matching its world area
+	UT_Vector3R wall_offset(const UT_Vector3R &uv0, const UT_Vector3R &uv1, const fpreal &wall_area) const;
+
+private:
+	const GEO_Primitive *host;
+	UT_Vector3R island_center;
+	fpreal area_ratio; // uv area per world area
+	GA_OffsetArray vertices;
+	UT_Array<UT_Vector3R> uvs;
+	mutable UT_Array<GA_Offset> weight_vertices;
+	mutable UT_FloatArray weights;
+};
@@ -0,0 +1,396 @@
+#include <GU/GU_Detail.h>
+#include <GA/GA_Types.h>
+#include <GEO/GEO_PrimPoly.h>
+#include <UT/UT_StringArray.h>
+#include <UT/UT_BoundingBox.h>
+#include <SYS/SYS_Math.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "Generator.h"
+#include "BinaryMesh.h"
+#include "GeoHash.h"
+
+// Headless greebling for batch jobs: hreeble_cli [--parm value...] input output
+// Parameters use the SOP names. .hmesh files are mapped directly, any other
+// format goes through GU_Detail (.bgeo, .obj, .ply, ...).
+// With --tiles N the input is cut into N spatial slabs, each greebled by its
+// own worker process, and the .hmesh results are concatenated. Faces keep
+// their input index as seed, so the merged result matches a single run up to
+// primitive order and the points shared across slab borders: those aren't
+// welded, faces on either side keep their own copy. --tiles 1 runs the same
+// path in one worker, so its output carries the face ids tiles add.
+// --checksum prints a content hash of the output with the generation time, the
+// input can be synthetic:<quads|tris|ngons|mixed>:<faces per row> and the
+// output - to skip writing. --expect fails the run when the hash differs.
+// --face_checksum hashes the written .hmesh faces instead, ignoring their
+// order and point sharing, so --tiles N can be compared with --tiles 1.
+
+namespace {
+	struct CliParm
+	{
+		const char *name;
+		int num_values;
+		void (*set)(GeneratorParms &parms, char **values);
+	};
+
+	uint to_uint(const char *value) { return uint(strtoul(value, nullptr, 10)); }
+	fpreal to_float(const char *value) { return strtod(value, nullptr); }
+
+	const CliParm cli_parms[] = {
+		{ "seed", 1, [](GeneratorParms &p, char **v) { p.seed = to_uint(v[0]); } },
+		{ "gen_panels", 1, [](GeneratorParms &p, char **v) { p.generate_panels = to_uint(v[0]); } },
+		{ "panel_inset", 1, [](GeneratorParms &p, char **v) { p.panel_inset = to_float(v[0]); } },
+		{ "panel_height", 2, [](GeneratorParms &p, char **v) { p.panel_height[0] = to_float(v[0]); p.panel_height[1] = to_float(v[1]); } },
+		{ "elem_density", 1, [](GeneratorParms &p, char **v) { p.elem_density = to_uint(v[0]); } },
+		{ "elem_scale", 2, [](GeneratorParms &p, char **v) { p.elem_scale[0] = to_float(v[0]); p.elem_scale[1] = to_float(v[1]); } },
+		{ "elem_height", 2, [](GeneratorParms &p, char **v) { p.elem_height[0] = to_float(v[0]); p.elem_height[1] = to_float(v[1]); } },
+		{ "elem_shapes", 1, [](GeneratorParms &p, char **v) { p.shapes = to_uint(v[0]); } },
+		{ "convex", 1, [](GeneratorParms &p, char **v) { p.convex = to_uint(v[0]); } },
+		{ "elem_groups", 1, [](GeneratorParms &p, char **v) { p.create_groups = to_uint(v[0]); } },
+		{ "unwrap_uvs", 1, [](GeneratorParms &p, char **v) { p.unwrap_uvs = to_uint(v[0]); } },
+		{ "inherit_attribs", 1, [](GeneratorParms &p, char **v) { p.inherit_attribs = to_uint(v[0]); } },
+		{ "output_mode", 1, [](GeneratorParms &p, char **v) { p.output_mode = static_cast<OutputModes>(to_uint(v[0])); } },
+		{ "chunked_cook", 1, [](GeneratorParms &p, char **v) { p.chunked_cook = to_uint(v[0]); } },
+		{ "chunk_size", 1, [](GeneratorParms &p, char **v) { p.chunk_size = SYSmax(exint(to_uint(v[0])), exint(1)); } },
+		{ "memory_budget", 1, [](GeneratorParms &p, char **v) { p.memory_budget = to_float(v[0]); } },
+		{ "lod_mode", 1, [](GeneratorParms &p, char **v) { p.lod_mode = static_cast<LODModes>(to_uint(v[0])); } },
+		{ "lod_camera", 3, [](GeneratorParms &p, char **v) { p.lod_camera = UT_Vector3(to_float(v[0]), to_float(v[1]), to_float(v[2])); } },
+		{ "lod_cap_size", 1, [](GeneratorParms &p, char **v) { p.lod_cap_size = to_float(v[0]); } },
+		{ "lod_cull_size", 1, [](GeneratorParms &p, char **v) { p.lod_cull_size = to_float(v[0]); } },
+		{ "shape_library", 1, [](GeneratorParms &p, char **v) { p.shape_library = v[0]; } },
+		{ "library_shapes", 1, [](GeneratorParms &p, char **v) { p.library_shapes = v[0]; } },
+		{ "cap_triangles", 1, [](GeneratorParms &p, char **v) { p.cap_triangles = to_uint(v[0]); } },
+		{ "elem_bevel", 1, [](GeneratorParms &p, char **v) { p.elem_bevel = to_float(v[0]); } },
+		{ "panel_bevel", 1, [](GeneratorParms &p, char **v) { p.panel_bevel = to_float(v[0]); } },
+		{ "bevel_shape", 1, [](GeneratorParms &p, char **v) { p.bevel_shape = static_cast<BevelShapes>(to_uint(v[0])); } },
+		{ "bevel_segments", 1, [](GeneratorParms &p, char **v) { p.bevel_segments = int(to_uint(v[0])); } },
+		{ "elem_tiers", 1, [](GeneratorParms &p, char **v) { p.elem_tiers = to_uint(v[0]); } },
+		{ "tier_falloff", 1, [](GeneratorParms &p, char **v) { p.tier_falloff = to_float(v[0]); } },
+		{ "pack_uvs", 1, [](GeneratorParms &p, char **v) { p.pack_uvs = to_uint(v[0]); } },
+		{ "uv_tile", 1, [](GeneratorParms &p, char **v) { p.uv_tile = int(to_uint(v[0])); } },
+		{ "output_normals", 1, [](GeneratorParms &p, char **v) { p.output_normals = to_uint(v[0]); } },
+		{ "watertight", 1, [](GeneratorParms &p, char **v) { p.watertight = static_cast<WatertightModes>(to_uint(v[0])); } },
+		{ "mesh_file", 1, [](GeneratorParms &p, char **v) { p.mesh_file = v[0]; } },
+	};
+
+	void usage()
+	{
+		fprintf(stderr, "usage: hreeble_cli [--source_groups group | --tiles count] [--checksum | --face_checksum] [--expect hash] [--<parm> value...] input output\n");
+		fprintf(stderr, "--tiles doesn't weld points along slab borders, --face_checksum compares it with --tiles 1\n");
+		fprintf(stderr, "parms:");
+		for (const auto &parm : cli_parms)
+			fprintf(stderr, " %s", parm.name);
+		fprintf(stderr, "\n");
+	}
+
+	// Prints the checksum line, false when it isn't the expected one
+	bool report_checksum(const uint64 &hash_value, const char *expected, const exint &num_faces, const exint &num_prims, const fpreal &seconds)
+	{
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)hash_value);
+		bool matched = !expected || !strcmp(hash, expected);
+		printf("%s %lld faces -> %lld prims in %.1f ms, %.0f faces/s%s\n", hash, (long long)num_faces, (long long)num_prims,
+			   seconds * 1000.0, num_faces / SYSmax(seconds, 1e-9), matched ? "" : " MISMATCH");
+		return matched;
+	}
+
+	// Face checksum of a written .hmesh, as the next tool would read it
+	bool output_face_checksum(const char *path, const char *expected, const exint &num_faces, const fpreal &seconds, bool &matched)
+	{
+		GU_Detail output;
+		UT_String error;
+		if (!hreeble::load_hmesh(path, &output, error)) {
+			fprintf(stderr, "hreeble_cli: %s\n", error.buffer());
+			return false;
+		}
+		matched = report_checksum(hreeble::hash_faces(&output), expected, num_faces, output.getNumPrimitives(), seconds);
+		return true;
+	}
+
+	// Rows of regular polygons in the xz plane, with vertex uvs and a primitive Cd to inherit
+	bool make_synthetic(const char *spec, GU_Detail &gdp)
+	{
+		char kind[16];
+		int size;
+		if (sscanf(spec, "synthetic:%15[a-z]:%d", kind, &size) != 2 || size < 1)
+			return false;
+		int sides;
+		if (!strcmp(kind, "quads"))
+			sides = 4;
+		else if (!strcmp(kind, "tris"))
+			sides = 3;
+		else if (!strcmp(kind, "ngons"))
+			sides = 6;
+		else if (!strcmp(kind, "mixed"))
+			sides = 0;
+		else
+			return false;
+		GA_RWHandleV3 uvh(gdp.addTextureAttribute(GA_ATTRIB_VERTEX));
+		GA_RWHandleV3 cdh(gdp.addDiffuseAttribute(GA_ATTRIB_PRIMITIVE));
+		for (int row = 0; row < size; row++) {
+			for (int col = 0; col < size; col++) {
+				int n = sides != 0 ? sides : 3 + (row + col) % 4;
+				GEO_PrimPoly *poly = GEO_PrimPoly::build(&gdp, n, false, true);
+				for (int v = 0; v < n; v++) {
+					// Clockwise seen from above, so faces point up
+					fpreal angle = M_PI * (0.25 + 2.0 * v / n);
+					UT_Vector3 pos(col + 0.5 + 0.5 * SYScos(angle), 0.0, row + 0.5 + 0.5 * SYSsin(angle));
+					gdp.setPos3(poly->getPointOffset(v), pos);
+					uvh.set(poly->getVertexOffset(v), UT_Vector3(pos.x() / size, pos.z() / size, 0.0));
+				}
+				cdh.set(poly->getMapOffset(), UT_Vector3(fpreal(col) / size, fpreal(row) / size, 0.5));
+			}
+		}
+		return true;
+	}
+
+	bool concat_files(const std::vector<std::string> &inputs, const char *output)
+	{
+		FILE *out = fopen(output, "wb");
+		if (!out)
+			return false;
+		bool ok = true;
+		std::vector<char> buffer(1 << 20);
+		for (const auto &input : inputs) {
+			FILE *in = fopen(input.c_str(), "rb");
+			ok = in != nullptr;
+			size_t bytes;
+			while (ok && (bytes = fread(buffer.data(), 1, buffer.size(), in)) != 0)
+				ok = fwrite(buffer.data(), 1, bytes, out) == bytes;
+			if (in)
+				fclose(in);
+			if (!ok)
+				break;
+		}
+		fclose(out);
+		return ok;
+	}
+
+	int run_tiles(char *exe, const std::vector<char*> &parm_args, GU_Detail &gdp, const GeneratorParms &parms,
+				  const int &num_tiles, const char *output)
+	{
+#ifdef _WIN32
+		fprintf(stderr, "hreeble_cli: --tiles needs fork, run the tiles as separate jobs instead\n");
+		return 1;
+#else
+		// Ids are taken after the convex pass, like a single run numbers its faces
+		if (parms.convex == 1)
+			gdp.convex(GA_Size(4));
+		GA_RWHandleI face_id(gdp.addIntTuple(GA_ATTRIB_PRIMITIVE, FACE_ID_ATTRIB, 1));
+		GA_OffsetList faces;
+		for (GA_Iterator it(gdp.getPrimitiveRange()); !it.atEnd(); ++it) {
+			face_id.set(*it, int(gdp.primitiveIndex(*it)));
+			faces.append(*it);
+		}
+
+		// Equal face counts per slab along the longest axis of the input
+		UT_BoundingBox bbox;
+		gdp.getBBox(&bbox);
+		int axis = bbox.sizeX() >= bbox.sizeY() ? (bbox.sizeX() >= bbox.sizeZ() ? 0 : 2) : (bbox.sizeY() >= bbox.sizeZ() ? 1 : 2);
+		std::vector<fpreal32> centers(gdp.getNumPrimitiveOffsets());
+		for (exint f = 0; f < faces.entries(); f++)
+			centers[faces(f)] = gdp.getGEOPrimitive(faces(f))->baryCenter()(axis);
+		std::vector<GA_Offset> order;
+		for (exint f = 0; f < faces.entries(); f++)
+			order.push_back(faces(f));
+		std::stable_sort(order.begin(), order.end(), [&centers](const GA_Offset &a, const GA_Offset &b) { return centers[a] < centers[b]; });
+
+		std::vector<std::string> tile_inputs, tile_outputs;
+		UT_String error;
+		for (int t = 0; t < num_tiles; t++) {
+			size_t start = order.size() * t / num_tiles, end = order.size() * (t + 1) / num_tiles;
+			GA_OffsetList tile_faces;
+			for (size_t f = start; f < end; f++)
+				tile_faces.append(order[f]);
+			tile_inputs.push_back(std::string(output) + ".tile" + std::to_string(t) + ".in.hmesh");
+			tile_outputs.push_back(std::string(output) + ".tile" + std::to_string(t) + ".out.hmesh");
+			if (!hreeble::save_hmesh(&gdp, tile_inputs.back().c_str(), error, &tile_faces)) {
+				fprintf(stderr, "hreeble_cli: %s\n", error.buffer());
+				return 1;
+			}
+		}
+
+		std::vector<pid_t> workers;
+		for (int t = 0; t < num_tiles; t++) {
+			std::vector<char*> args;
+			args.push_back(exe);
+			args.insert(args.end(), parm_args.begin(), parm_args.end());
+			args.push_back(const_cast<char*>(tile_inputs[t].c_str()));
+			args.push_back(const_cast<char*>(tile_outputs[t].c_str()));
+			args.push_back(nullptr);
+			pid_t pid = fork();
+			if (pid == 0) {
+				execvp(exe, args.data());
+				_exit(127);
+			}
+			workers.push_back(pid);
+		}
+		bool ok = true;
+		for (auto pid : workers) {
+			int status = 0;
+			ok = pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+		}
+		ok = ok && concat_files(tile_outputs, output);
+		for (int t = 0; t < num_tiles; t++) {
+			remove(tile_inputs[t].c_str());
+			remove(tile_outputs[t].c_str());
+		}
+		if (!ok) {
+			fprintf(stderr, "hreeble_cli: a tile worker failed, no output written\n");
+			remove(output);
+			return 1;
+		}
+		return 0;
+#endif
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	GeneratorParms parms;
+	const char *group_name = nullptr;
+	int num_tiles = 0; // no tiling
+	bool checksum = false;
+	bool face_checksum = false;
+	const char *expected = nullptr;
+	std::vector<char*> parm_args; // forwarded to tile workers
+	const char *paths[2] = { nullptr, nullptr };
+	int num_paths = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--", 2) != 0) {
+			if (num_paths == 2) {
+				usage();
+				return 1;
+			}
+			paths[num_paths++] = argv[i];
+			continue;
+		}
+		const char *name = argv[i] + 2;
+		if (!strcmp(name, "source_groups") && i + 1 < argc) {
+			group_name = argv[++i];
+			continue;
+		}
+		if (!strcmp(name, "tiles") && i + 1 < argc) {
+			num_tiles = SYSmax(atoi(argv[++i]), 1);
+			continue;
+		}
+		if (!strcmp(name, "checksum")) {
+			checksum = true;
+			continue;
+		}
+		if (!strcmp(name, "face_checksum")) {
+			face_checksum = true;
+			continue;
+		}
+		if (!strcmp(name, "expect") && i + 1 < argc) {
+			expected = argv[++i];
+			checksum = true;
+			continue;
+		}
+		const CliParm *found = nullptr;
+		for (const auto &parm : cli_parms) {
+			if (!strcmp(name, parm.name))
+				found = &parm;
+		}
+		if (!found || i + found->num_values >= argc) {
+			usage();
+			return 1;
+		}
+		found->set(parms, argv + i + 1);
+		for (int v = 0; v <= found->num_values; v++)
+			parm_args.push_back(argv[i + v]);
+		i += found->num_values;
+	}
+	if (num_paths != 2) {
+		usage();
+		return 1;
+	}
+	if (face_checksum && !hreeble::is_hmesh_path(paths[1])) {
+		fprintf(stderr, "hreeble_cli: --face_checksum reads the output back, it has to be a .hmesh file\n");
+		return 1;
+	}
+	if (num_tiles > 0 && (group_name || parms.pack_uvs != 0 || !hreeble::is_hmesh_path(paths[1]))) {
+		// Groups don't travel with tiles and one uv atlas spans the whole output
+		fprintf(stderr, "hreeble_cli: --tiles writes .hmesh and can't be combined with --source_groups or --pack_uvs\n");
+		return 1;
+	}
+
+	GU_Detail gdp;
+	UT_StringArray io_errors;
+	UT_String mesh_error;
+	if (!strncmp(paths[0], "synthetic:", 10)) {
+		if (!make_synthetic(paths[0], gdp)) {
+			fprintf(stderr, "hreeble_cli: unknown synthetic input %s\n", paths[0]);
+			return 1;
+		}
+	}
+	else if (hreeble::is_hmesh_path(paths[0])) {
+		if (!hreeble::load_hmesh(paths[0], &gdp, mesh_error)) {
+			fprintf(stderr, "hreeble_cli: %s\n", mesh_error.buffer());
+			return 1;
+		}
+	}
+	else if (!gdp.load(paths[0], nullptr, &io_errors).success()) {
+		fprintf(stderr, "hreeble_cli: could not read %s\n", paths[0]);
+		return 1;
+	}
+	if (num_tiles > 0) {
+		exint num_faces = gdp.getNumPrimitives();
+		auto start = std::chrono::steady_clock::now();
+		int result = run_tiles(argv[0], parm_args, gdp, parms, num_tiles, paths[1]);
+		fpreal seconds = std::chrono::duration<fpreal>(std::chrono::steady_clock::now() - start).count();
+		if (result != 0 || !face_checksum)
+			return result;
+		bool matched;
+		if (!output_face_checksum(paths[1], expected, num_faces, seconds, matched))
+			return 1;
+		return matched ? 0 : 1;
+	}
+	const GA_PrimitiveGroup *source_group = nullptr;
+	if (group_name) {
+		source_group = gdp.findPrimitiveGroup(group_name);
+		if (!source_group) {
+			fprintf(stderr, "hreeble_cli: no primitive group %s in %s\n", group_name, paths[0]);
+			return 1;
+		}
+	}
+
+	Generator generator;
+	exint num_faces = source_group ? source_group->entries() : gdp.getNumPrimitives();
+	auto start = std::chrono::steady_clock::now();
+	if (generator.generate(&gdp, source_group, parms) != GeneratorResult::DONE) {
+		fprintf(stderr, "hreeble_cli: %s\n", generator.error().isstring() ? generator.error().buffer() : "generation was interrupted");
+		return 1;
+	}
+	fpreal seconds = std::chrono::duration<fpreal>(std::chrono::steady_clock::now() - start).count();
+	if (generator.warning().isstring())
+		fprintf(stderr, "hreeble_cli: %s\n", generator.warning().buffer());
+	bool matched = true;
+	if (checksum && !face_checksum)
+		matched = report_checksum(hreeble::hash_geometry(&gdp), expected, num_faces, gdp.getNumPrimitives(), seconds);
+	if (!strcmp(paths[1], "-"))
+		return matched ? 0 : 1;
+	if (hreeble::is_hmesh_path(paths[1])) {
+		if (!hreeble::save_hmesh(&gdp, paths[1], mesh_error)) {
+			fprintf(stderr, "hreeble_cli: %s\n", mesh_error.buffer());
+			return 1;
+		}
+	}
+	else if (!gdp.save(paths[1], nullptr, &io_errors).success()) {
+		fprintf(stderr, "hreeble_cli: could not write %s\n", paths[1]);
+		return 1;
+	}
+	if (face_checksum && !output_face_checksum(paths[1], expected, num_faces, seconds, matched))
+		return 1;
+	return matched ? 0 : 1;
+}
@@ -1,417 +1,364 @@
-#include <iostream>
-#include <OP/OP_Operator.h>
-#include <OP/OP_OperatorTable.h>
-#include <OP/OP_AutoLockInputs.h>
-#include <UT/UT_ValArray.h>
-#include <UT/UT_Vector2.h>
-#include <UT/UT_Interrupt.h>
-#include <SYS/SYS_Math.h>
-#include <GU/GU_Detail.h>
-#include <GU/GU_PrimPoly.h>
-#include <GA/GA_ElementWrangler.h>
-#include <GEO/GEO_PolyCounts.h>
-#include "sop_hreeble.h"
-#include "Element.h"
-#include "misc.h"
-
-typedef UT_Vector2R V2R;
-typedef UT_Pair<GA_Offset, GA_Offset> OffsetPair;
-
-static PRM_Name prm_names[] = { PRM_Name("panel_height", "Panel Height"),
-								PRM_Name("panel_inset", "Panel Inset"),
-								PRM_Name("elem_density", "Elements Density"),
-								PRM_Name("elem_scale", "Element Scale"),
-								PRM_Name("elem_height", "Element Height"),
-								PRM_Name("elem_shapes", "Element Shapes"),
-								PRM_Name("gen_panels", "Generate Panels"),
-								PRM_Name("source_groups", "Source Prim Group"),
-								PRM_Name("elem_groups", "Create Output Groups"),
-								PRM_Name("convex", "Convex Geometry"),
-								PRM_Name("unwrap_uvs", "Auto Unwrap UVs"),
-								PRM_Name("inherit_attribs", "Inherit Prim Attribs") };
-
-static PRM_Default seed_def(12345);
-static PRM_Default inset_def(0.01);
-static PRM_Default panel_height_def[] = { PRM_Default(0.001), PRM_Default(0.1) };
-static PRM_Default elem_scale_def[] = { PRM_Default(0.5), PRM_Default(1.0) };
-static PRM_Default elem_height_def[] = { PRM_Default(0.02), PRM_Default(0.1) };
-static PRM_Default elem_shapes_def = PRM_Default(4);
-static PRM_Range seed_range(PRM_RANGE_RESTRICTED, 1, PRM_RANGE_UI, 45000);
-static PRM_Range panel_height_range(PRM_RANGE_RESTRICTED, 0.001, PRM_RANGE_UI, 0.1);
-static PRM_Range elem_density_range(PRM_RANGE_RESTRICTED, 1, PRM_RANGE_UI, 10);
-static PRM_Range elem_scale_range(PRM_RANGE_RESTRICTED, 0.0, PRM_RANGE_UI, 1);
-static PRM_Range elem_height_range(PRM_RANGE_UI, 0.0001, PRM_RANGE_UI, 1);
-
-static PRM_Item elem_shapes[] = { PRM_Item("stripev", "StripeV", "hr_stripe1"),
-								  PRM_Item("stripev2", "StripeV2", "hr_stripe2"),
-								  PRM_Item("stripev3", "StripeV3", "hr_stripe3"), 
-								  PRM_Item("tshape", "TShape", "hr_tshape"), 
-								  PRM_Item("rshape", "RShape", "hr_rshape"), 
-								  PRM_Item("square", "Square", "hr_square"), 
-								  PRM_Item(),};
-
-static PRM_ChoiceList elem_shapes_list(PRM_CHOICELIST_TOGGLE, elem_shapes);
-static uint prm_num_shapes = sizeof(elem_shapes) / sizeof(PRM_Item);
-
-PRM_Template SOP_Hreeble::myparms[] = {
-	PRM_Template(PRM_STRING, 1, &prm_names[7], 0, &SOP_Node::primGroupMenu, 0, 0, SOP_Node::getGroupSelectButton(GA_GROUP_PRIMITIVE)),
-	PRM_Template(PRM_INT, 1, &PRMseedName, &seed_def, 0, &seed_range), /*seed*/
-	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[6], PRMoneDefaults), /*generate panels*/
-	PRM_Template(PRM_FLT, 1, &prm_names[1], &inset_def), /*inset*/
-	PRM_Template(PRM_FLT, 2, &prm_names[0], panel_height_def, 0, &panel_height_range), /*height*/
-	PRM_Template(PRM_INT, 1, &prm_names[2], PRMoneDefaults, 0, &elem_density_range), /*element density*/
-	PRM_Template(PRM_FLT, 2, &prm_names[3], elem_scale_def, 0, &elem_scale_range), /*element scale*/
-	PRM_Template(PRM_FLT, 2, &prm_names[4], elem_height_def, 0, &elem_height_range), /*element height*/
-	PRM_Template(PRM_ICONSTRIP, 1 , &prm_names[5], &elem_shapes_def, &elem_shapes_list),
-	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[9], PRMoneDefaults), /*convex geometry*/
-	PRM_Template(PRM_TOGGLE_E, 1 , &prm_names[8], PRMzeroDefaults), /*create groups*/
-	PRM_Template(PRM_TOGGLE_E, 1 , &prm_names[10], PRMzeroDefaults), /*auto generate uv*/
-	PRM_Template(PRM_TOGGLE_E, 1 , &prm_names[11], PRMoneDefaults), /*inherit source prim attribs*/
-	PRM_Template()
-};
-
-bool SOP_Hreeble::updateParmsFlags() {
-	bool changed = SOP_Node::updateParmsFlags();
-	uint generate_pannels = GeneratePanelsPRM();
-	uint elem_shapes = SelectedShapesPRM();
-	changed |= enableParm("panel_height", generate_pannels);
-	changed |= enableParm("panel_inset", generate_pannels);
-	changed |= enableParm("elem_density", elem_shapes);
-	changed |= enableParm("elem_scale", elem_shapes);
-	changed |= enableParm("elem_height", elem_shapes);
-	changed |= enableParm("elem_groups", elem_shapes);
-	return changed;
-}
-
-void newSopOperator(OP_OperatorTable *table) {
-	table->addOperator(new OP_Operator(
-		"hreeble",
-		"Hreeble",
-		SOP_Hreeble::creator,
-		SOP_Hreeble::myparms,
-		1,
-		1));
-}
-
-SOP_Hreeble::SOP_Hreeble(OP_Network * net, const char * name, OP_Operator * op):
-	SOP_Node(net, name, op), my_seed(0), source_prim_group(nullptr), elements_group(nullptr), elements_front_group(nullptr), uvattr(nullptr)
-{
-	//flags().timeDep = 1;
-}
-
-SOP_Hreeble::~SOP_Hreeble() { }
-
-OP_Node * SOP_Hreeble::creator(OP_Network *net, const char *name, OP_Operator *op)
-{
-	return new SOP_Hreeble(net, name, op);
-}
-
-OP_ERROR SOP_Hreeble::cookInputGroups(OP_Context & ctx, int alone)
-{
-	return cookInputPrimitiveGroups(ctx, source_prim_group, alone);
-}
-
-void SOP_Hreeble::split_primitive(GEO_Primitive * source_prim, UT_ValArray<GEO_Primitive*>& result, const unsigned short dir)
-{
-	GA_OffsetArray prim_ptoffs;
-	GA_OffsetArray prim_vtoffs;
-	for (GA_Iterator it(source_prim->getVertexRange()); !it.atEnd(); ++it){
-		prim_vtoffs.append(*it);
-		prim_ptoffs.append(gdp->vertexPoint(*it));
-	}
-
-	GA_Offset new_ptof = gdp->appendPointBlock(2);
-	GA_VertexWrangler twrangler(*gdp);
-	//auto VtxToPt = [this](const GEO_PrimPoly *prim, const GA_Size &index) {return gdp->vertexPoint(prim->getVertexOffset(index)); };
-	GEO_PrimPoly *prim1 = GEO_PrimPoly::build(gdp, 4, false, false);
-	GEO_PrimPoly *prim2 = GEO_PrimPoly::build(gdp, 4, false, false);
-	if (dir == 0) {
-		auto svec0 = phandle.get(prim_ptoffs(3)) - phandle.get(prim_ptoffs(0));
-		auto svec1 = phandle.get(prim_ptoffs(2)) - phandle.get(prim_ptoffs(1));
-		phandle.set(new_ptof, phandle.get(prim_ptoffs(1)) + svec1 * 0.5); // vertex  top middle
-		phandle.set(new_ptof + 1, phandle.get(prim_ptoffs(0)) + svec0 * 0.5); // vertex bottom middle
-		
-		prim1->setVertexPoint(0, prim_ptoffs(0));
-		twrangler.copyAttributeValues(prim1->getVertexOffset(0), prim_vtoffs(0));
-		prim1->setVertexPoint(1, prim_ptoffs(1));
-		twrangler.copyAttributeValues(prim1->getVertexOffset(1), prim_vtoffs(1));
-		prim1->setVertexPoint(2, new_ptof);
-		twrangler.lerpAttributeValues(prim1->getVertexOffset(2), prim_vtoffs(1), prim_vtoffs(2), 0.5);
-		prim1->setVertexPoint(3, new_ptof + 1);
-		twrangler.lerpAttributeValues(prim1->getVertexOffset(3), prim_vtoffs(0), prim_vtoffs(3), 0.5);
-		
-		prim2->setVertexPoint(0, new_ptof+1);
-		twrangler.lerpAttributeValues(prim2->getVertexOffset(0), prim_vtoffs(0), prim_vtoffs(3), 0.5);
-		prim2->setVertexPoint(1, new_ptof);
-		twrangler.lerpAttributeValues(prim2->getVertexOffset(1), prim_vtoffs(1), prim_vtoffs(2), 0.5);
-		prim2->setVertexPoint(2, prim_ptoffs(2));
-		twrangler.copyAttributeValues(prim2->getVertexOffset(2), prim_vtoffs(2));
-		prim2->setVertexPoint(3, prim_ptoffs(3));
-		twrangler.copyAttributeValues(prim2->getVertexOffset(3), prim_vtoffs(3));
-	}
-	else {
-		auto svec0 = phandle.get(prim_ptoffs(1)) - phandle.get(prim_ptoffs(0));
-		auto svec1 = phandle.get(prim_ptoffs(2)) - phandle.get(prim_ptoffs(3));
-		phandle.set(new_ptof, phandle.get(prim_ptoffs(0)) + svec0 * 0.5); // vertex  left middle
-		phandle.set(new_ptof+1, phandle.get(prim_ptoffs(3)) + svec1 * 0.5); // vertex right middle
-		
-		prim1->setVertexPoint(0, prim_ptoffs(0));
-		twrangler.copyAttributeValues(prim1->getVertexOffset(0), prim_vtoffs(0));
-		prim1->setVertexPoint(1, new_ptof);
-		twrangler.lerpAttributeValues(prim1->getVertexOffset(1), prim_vtoffs(0), prim_vtoffs(1), 0.5);
-		prim1->setVertexPoint(2, new_ptof + 1);
-		twrangler.lerpAttributeValues(prim1->getVertexOffset(2), prim_vtoffs(2), prim_vtoffs(3), 0.5);
-		prim1->setVertexPoint(3, prim_ptoffs(3));
-		twrangler.copyAttributeValues(prim1->getVertexOffset(3), prim_vtoffs(3));
-		
-		prim2->setVertexPoint(0, new_ptof);
-		twrangler.lerpAttributeValues(prim2->getVertexOffset(0), prim_vtoffs(0), prim_vtoffs(1), 0.5);
-		prim2->setVertexPoint(1, prim_ptoffs(1));
-		twrangler.copyAttributeValues(prim2->getVertexOffset(1), prim_vtoffs(1));
-		prim2->setVertexPoint(2, prim_ptoffs(2));
-		twrangler.copyAttributeValues(prim2->getVertexOffset(2), prim_vtoffs(2));
-		prim2->setVertexPoint(3, new_ptof + 1);
-		twrangler.lerpAttributeValues(prim2->getVertexOffset(3), prim_vtoffs(2), prim_vtoffs(3), 0.5);
-	}
-
-	if (inherit_attribs != 0) {
-		prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, prim1->getMapOffset(), GA_ATTRIB_PRIMITIVE, source_prim->getMapOffset());
-		prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, prim2->getMapOffset(), GA_ATTRIB_PRIMITIVE, source_prim->getMapOffset());
-	}
-
-	result.append((GEO_Primitive*)prim1);
-	result.append((GEO_Primitive*)prim2);
-	kill_prims.append(source_prim);
-}
-
-void SOP_Hreeble::divide(GEO_Primitive * prim, UT_ValArray<GEO_Primitive*>& result)
-{
-	unsigned short dir = SYStrunc(SYSrandom(my_seed) * 2);
-	auto prim_to_split = prim;
-	split_primitive(prim_to_split, result, dir);
-
-	auto nr = my_seed * 1999;
-	unsigned short index = SYStrunc(SYSrandom(nr) * 2);
-	prim_to_split = result(index);
-	result.removeIndex(index);
-	split_primitive(prim_to_split, result, (1 - dir));
-	if (inherit_attribs != 0) {
-		for (auto &new_prim : result) {
-			prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, new_prim->getMapOffset(), GA_ATTRIB_PRIMITIVE, prim->getMapOffset());
-		}
-	}
-}
-
-GEO_Primitive* SOP_Hreeble::extrude(GEO_Primitive * source_prim, const fpreal & height, const fpreal &inset)
-{
-	UT_Vector3 primN = source_prim->computeNormal();
-	UT_Vector4 primP;
-	source_prim->evaluateInteriorPoint(primP, 0.5, 0.5);
-	UT_Vector3 top_center = primP + primN * height;
-	GA_VertexWrangler vtxwrangler(*gdp);
-	UT_Array<GEO_PrimPoly*> resulted_prims;
-	UT_Vector3R island_center(0.0, 0.0, 0.0);
-	fpreal uv_area, source_prim_area;
-	GA_Size numvertex = source_prim->getVertexCount();
-	GA_RWHandleV3D uvhandle;
-	if (unwrap_uvs != 0) {
-		uvhandle = uvattr;
-		for (GA_Iterator it(source_prim->getVertexRange()); !it.atEnd();++it){
-			island_center += uvhandle.get(*it);
-		}
-		island_center /= numvertex;
-		island_center.z() = 0.0;
-		// Calc source prim area and uv_area
-		source_prim_area = source_prim->calcArea();
-		UT_Vector3R v1 = uvhandle.get(source_prim->getVertexOffset(1)) - uvhandle.get(source_prim->getVertexOffset(0));
-		UT_Vector3R v2 = uvhandle.get(source_prim->getVertexOffset(numvertex - 1)) - uvhandle.get(source_prim->getVertexOffset(0));
-		uv_area = v1.length() * v2.length();
-	}
-
-	GA_Offset point_block = gdp->appendPointBlock(numvertex);
-	auto VtxToPt = [this, source_prim](const GA_Size &index) {return gdp->vertexPoint(source_prim->getVertexOffset(index)); };
-	for (GA_Size i = 0;i < numvertex; i++) {
-		bool last = (i == numvertex - 1 ? true : false);
-		GA_Offset prev, next = point_block;
-		UT_Vector3 pt2_pos, pt3_pos, inset_dir;
-		GA_Offset pt0 = VtxToPt(i);
-		GA_Offset pt1 = VtxToPt(last ? 0 : i + 1);
-
-		GA_Offset pt2 = point_block + (last ? 0 : i + 1);
-		GA_Offset pt3 = point_block + i;
-		pt2_pos = phandle.get(pt1) + primN * height;
-		pt3_pos = phandle.get(pt0) + primN * height;
-		inset_dir = (top_center - pt2_pos);
-		inset_dir.normalize();
-		pt2_pos += inset_dir * inset;
-		phandle.set(pt2, pt2_pos);
-		inset_dir = (top_center - pt3_pos);
-		inset_dir.normalize();
-		pt3_pos += inset_dir * inset;
-		phandle.set(pt3, pt3_pos);
-
-		auto new_prim = GEO_PrimPoly::build(gdp, 4, false, false);
-		resulted_prims.append(new_prim);
-		new_prim->setVertexPoint(0, pt0);
-		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(0), source_prim->getVertexOffset(i));
-	
-		new_prim->setVertexPoint(1, pt1);
-		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(1), source_prim->getVertexOffset((last ? 0 : i + 1)));
-		
-		new_prim->setVertexPoint(2, pt2);
-		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(2), new_prim->getVertexOffset(1));
-		
-		new_prim->setVertexPoint(3, pt3);
-		vtxwrangler.copyAttributeValues(new_prim->getVertexOffset(3), new_prim->getVertexOffset(0));
-
-		if (unwrap_uvs != 0) {
-			UT_Vector3R edge = uvhandle.get(source_prim->getVertexOffset(last ? 0 : i + 1)) - uvhandle.get(source_prim->getVertexOffset(i));
-			fpreal uv_edge_len = edge.length();
-			fpreal extruded_prim_area = new_prim->calcArea();
-			fpreal uv_extruded_area = (extruded_prim_area * uv_area) / source_prim_area;
-			fpreal offset_val = uv_extruded_area / uv_edge_len;
-
-			UT_Vector3R vc = island_center - uvhandle.get(new_prim->getVertexOffset(0));
-			UT_Vector3R vv = uvhandle.get(new_prim->getVertexOffset(1)) - uvhandle.get(new_prim->getVertexOffset(0));
-			fpreal proj = vc.dot(vv) / vv.length();
-			vv.normalize();
-			UT_Vector3R projpoint = uvhandle.get(new_prim->getVertexOffset(0)) + vv * proj;
-			UT_Vector3R offset_dir = projpoint - island_center;
-			offset_dir.normalize();
-			uvhandle.add(new_prim->getVertexOffset(0), offset_dir * offset_val);
-			uvhandle.add(new_prim->getVertexOffset(1), offset_dir * offset_val);
-		}
-		
-	}
-		auto top_prim = GEO_PrimPoly::build(gdp, numvertex, false, false);
-		resulted_prims.append(top_prim);
-		for (int i = 0; i < numvertex; i++) {
-			top_prim->setVertexPoint(i, point_block + i);
-			vtxwrangler.copyAttributeValues(top_prim->getVertexOffset(i), source_prim->getVertexOffset(i));
-		}
-		kill_prims.append(source_prim);
-		if (inherit_attribs != 0) {
-			for (auto &new_prim : resulted_prims) {
-				prim_refmap.copyValue(GA_ATTRIB_PRIMITIVE, new_prim->getMapOffset(), GA_ATTRIB_PRIMITIVE, source_prim->getMapOffset());
-			}
-	}
-		return static_cast<GEO_Primitive*>(top_prim);
-
-}
-
-OP_ERROR SOP_Hreeble::cookMySop(OP_Context & ctx)
-{
-	fpreal time = ctx.getTime();
-	uint seed_parm = SeedPRM();
-	fpreal64 panel_height_parm[2];
-	fpreal64 elem_scale_parm[2];
-	fpreal64 elem_height_parm[2];
-	PanelHeightPRM(panel_height_parm, time);
-	ElemScalePRM(elem_scale_parm, time);
-	ElemHeightPRM(elem_height_parm, time);
-	fpreal panel_inset_parm = PanelInsetPRM();
-	uint element_density = ElemDensityPRM();
-	uint shapes_parm = SelectedShapesPRM();
-	uint generate_panels = GeneratePanelsPRM();
-	unwrap_uvs = UnwrapUVsPRM();
-	inherit_attribs = InheritAttribsPRM();
-
-	UT_ValArray<uint> selected_shapes;
-	for (uint i = 0; i < prm_num_shapes; i++) {
-		if ((shapes_parm & (0x01 << i)) != 0) {
-			selected_shapes.append(0x01 << i);
-		}
-	}
-
-	UT_AutoInterrupt boss("Making hreeble...");
-	OP_AutoLockInputs inputs(this);
-	if (error() > UT_ERROR_ABORT 
-		|| inputs.lock(ctx) >= UT_ERROR_ABORT
-		|| cookInputGroups(ctx) > UT_ERROR_ABORT 
-		|| (source_prim_group && source_prim_group->isEmpty()))
-		return error();
-
-	gdp->clearAndDestroy();
-	duplicateSource(0, ctx);
-	phandle = gdp->getP();
-	prim_refmap.bind(*gdp, *gdp);
-	if (inherit_attribs != 0) {
-		for (GA_AttributeDict::iterator it = gdp->primitiveAttribs().begin(); !it.atEnd(); ++it) {
-			prim_refmap.appendDest(it.attrib());
-		}
-	}
-	if (DoConvexPRM() == 1)
-		gdp->convex(GA_Size(4));
-	uint num_selected_shapes = selected_shapes.entries();
-	if (num_selected_shapes == 0 && generate_panels == 0) return error();
-	elements_group = nullptr;
-	elements_front_group = nullptr;
-	if (CreateGroupsPRM() != 0) {
-		elements_group = gdp->newPrimitiveGroup("elements");
-		elements_front_group = gdp->newPrimitiveGroup("elements_front");
-	}
-	if (unwrap_uvs != 0) {
-		uvattr = gdp->findTextureAttribute(GA_ATTRIB_VERTEX);
-		if (!uvattr) {
-			addError(SOP_ERR_MISSING_UV, "Please assign vertex UVs on source geometry");
-			return error();
-		}
-	}
-	UT_ValArray<GEO_Primitive*> panel_prims;
-	UT_ValArray<GEO_Primitive*> top_prims;
-	kill_prims.clear();
-	fpreal panel_height = 0.0;
-	my_seed = seed_parm;
-	for (GA_Iterator it(gdp->getPrimitiveRange(source_prim_group)); !it.atEnd(); ++it) {
-		GEO_Primitive *source_prim = static_cast<GEO_Primitive*>(gdp->getPrimitive(*it));
-		top_prims.clear();
-		if (boss.wasInterrupted())
-			break;
-		if (generate_panels != 0) {
-			panel_prims.clear();
-			if (source_prim->getVertexCount() == 4)
-				divide(source_prim, panel_prims); // Divide source prim into panels
-			else if (source_prim->getVertexCount() == 3)
-				panel_prims.append(source_prim);
-			for (auto prim : panel_prims) {
-				panel_height = SYSfit01((fpreal64)SYSfastRandom(my_seed), panel_height_parm[0], panel_height_parm[1]);
-				GEO_Primitive *extruded_front_prim = extrude(prim, panel_height, panel_inset_parm);
-				top_prims.append(extruded_front_prim);
-			}
-		}
-		else {
-			top_prims.append(source_prim);
-		}
-		if (num_selected_shapes != 0) {
-			for (const auto prim: top_prims){
-				UT_Vector3 primN = prim->computeNormal();
-				auto num_vtx = prim->getVertexCount();
-				ElementTypes type;
-				for (uint i = 0; i < element_density; i++) {
-					uint elem_seed = seed_parm + prim->getMapIndex() * 130145 + i * 12987;
-					if (num_vtx == 3)
-						type = ElementTypes::TRIANGLE;
-					else
-						type = static_cast<ElementTypes>(hreeble::rand_choice(selected_shapes, elem_seed));
-					fpreal elem_height = SYSfit01((fpreal64)SYSfastRandom(elem_seed), elem_height_parm[0], elem_height_parm[1]);
-					UT_Vector2R elem_pos(SYSfastRandom(elem_seed), SYSfastRandom(elem_seed));
-					fpreal elem_scale = SYSfit01((fpreal64)SYSfastRandom(elem_seed), elem_scale_parm[0], elem_scale_parm[1]);
-					auto element = make_element(type,
-												(short)hreeble::rand_bool(elem_seed),
-												inherit_attribs,
-												unwrap_uvs,
-												prim_refmap,
-												uvattr,
-												elements_group, elements_front_group);
-					element->transform(elem_pos, elem_scale, hreeble::rand_bool(elem_seed + 11234));
-					element->build(gdp, prim, primN, elem_height);
-				}
-			}
-		}
-	}
-
-	for (auto prim : kill_prims) {
-		gdp->destroyPrimitive((*prim), true);
-	}
-	return error();
-}
+#include <OP/OP_Operator.h>
+#include <OP/OP_OperatorTable.h>
+#include <OP/OP_AutoLockInputs.h>
+#include <GU/GU_Detail.h>
+#include <SYS/SYS_Math.h>
+#include "sop_hreeble.h"
+#include "MeshFile.h"
+
+static PRM_Name prm_names[] = { PRM_Name("panel_height", "Panel Height"),
+								PRM_Name("panel_inset", "Panel Inset"),
+								PRM_Name("elem_density", "Elements Density"),
+								PRM_Name("elem_scale", "Element Scale"),
+								PRM_Name("elem_height", "Element Height"),
+								PRM_Name("elem_shapes", "Element Shapes"),
+								PRM_Name("gen_panels", "Generate Panels"),
+								PRM_Name("source_groups", "Source Prim Group"),
+								PRM_Name("elem_groups", "Create Output Groups"),
+								PRM_Name("convex", "Convex Geometry"),
+								PRM_Name("unwrap_uvs", "Auto Unwrap UVs"),
+								PRM_Name("inherit_attribs", "Inherit Prim Attribs"),
+								PRM_Name("output_mode", "Element Output"),
+								PRM_Name("chunked_cook", "Chunked Cook"),
+								PRM_Name("chunk_size", "Chunk Size"),
+								PRM_Name("memory_budget", "Memory Budget (MB)"),
+								PRM_Name("lod_mode", "LOD Mode"),
+								PRM_Name("lod_camera", "LOD Camera Position"),
+								PRM_Name("lod_cap_size", "Cap Only Below Size"),
+								PRM_Name("lod_cull_size", "Cull Below Size"),
+								PRM_Name("shape_library", "Shape Library"),
+								PRM_Name("library_shapes", "Library Shapes"),
+								PRM_Name("cap_triangles", "Triangulate Caps"),
+								PRM_Name("elem_bevel", "Element Bevel"),
+								PRM_Name("panel_bevel", "Panel Bevel"),
+								PRM_Name("bevel_shape", "Bevel Profile"),
+								PRM_Name("bevel_segments", "Bevel Segments"),
+								PRM_Name("elem_tiers", "Element Tiers"),
+								PRM_Name("tier_falloff", "Tier Height Falloff"),
+								PRM_Name("pack_uvs", "Pack Element UVs"),
+								PRM_Name("uv_tile", "Element UV Tile"),
+								PRM_Name("output_normals", "Output Normals and Tangents"),
+								PRM_Name("watertight", "Watertight"),
+								PRM_Name("mesh_file", "Mesh File"),
+								PRM_Name("async_cook", "Background Cook"),
+								PRM_Name("preview_faces", "Preview Faces (%)"),
+								PRM_Name("fetch_result", "Fetch Background Result"),
+								PRM_Name("cache_dir", "Disk Cache Directory") };
+
+static PRM_Default seed_def(12345);
+static PRM_Default inset_def(0.01);
+static PRM_Default panel_height_def[] = { PRM_Default(0.001), PRM_Default(0.1) };
+static PRM_Default elem_scale_def[] = { PRM_Default(0.5), PRM_Default(1.0) };
+static PRM_Default elem_height_def[] = { PRM_Default(0.02), PRM_Default(0.1) };
+static PRM_Default elem_shapes_def = PRM_Default(4);
+static PRM_Range seed_range(PRM_RANGE_RESTRICTED, 1, PRM_RANGE_UI, 45000);
+static PRM_Range panel_height_range(PRM_RANGE_RESTRICTED, 0.001, PRM_RANGE_UI, 0.1);
+static PRM_Range elem_density_range(PRM_RANGE_RESTRICTED, 1, PRM_RANGE_UI, MAX_ELEM_DENSITY);
+static PRM_Range elem_scale_range(PRM_RANGE_RESTRICTED, 0.0, PRM_RANGE_UI, 1);
+static PRM_Range elem_height_range(PRM_RANGE_UI, 0.0001, PRM_RANGE_UI, 1);
+static PRM_Default chunk_size_def(10000);
+static PRM_Range chunk_size_range(PRM_RANGE_RESTRICTED, 1, PRM_RANGE_UI, 100000);
+static PRM_Range memory_budget_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 65536);
+
+static PRM_Name lod_modes[] = { PRM_Name("off", "Off"),
+								PRM_Name("camera", "Projected Size From Camera"),
+								PRM_Name("size", "World Size"),
+								PRM_Name(0) };
+static PRM_ChoiceList lod_mode_list(PRM_CHOICELIST_SINGLE, lod_modes);
+static PRM_Default lod_cap_size_def(0.01);
+static PRM_Default lod_cull_size_def(0.002);
+static PRM_Range lod_size_range(PRM_RANGE_RESTRICTED, 0.0, PRM_RANGE_UI, 0.1);
+static PRM_Default library_shapes_def(0, "*");
+
+static PRM_Name bevel_shapes[] = { PRM_Name("chamfer", "Chamfer"),
+								   PRM_Name("round", "Round"),
+								   PRM_Name(0) };
+static PRM_ChoiceList bevel_shape_list(PRM_CHOICELIST_SINGLE, bevel_shapes);
+static PRM_Range bevel_range(PRM_RANGE_RESTRICTED, 0.0, PRM_RANGE_RESTRICTED, 1.0);
+static PRM_Range bevel_segments_range(PRM_RANGE_RESTRICTED, 1, PRM_RANGE_UI, 8);
+static PRM_Range elem_tiers_range(PRM_RANGE_RESTRICTED, 1, PRM_RANGE_UI, 4);
+static PRM_Default tier_falloff_def(0.5);
+static PRM_Range uv_tile_range(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 9);
+static PRM_Range preview_faces_range(PRM_RANGE_RESTRICTED, 0.0, PRM_RANGE_RESTRICTED, 100.0);
+
+// Worker threads may not dirty nodes, the finished result is picked up by a recook from the UI
+static int fetch_background_result(void *data, int, fpreal, const PRM_Template *)
+{
+	static_cast<SOP_Hreeble*>(data)->forceRecook();
+	return 1;
+}
+
+static PRM_Name watertight_modes[] = { PRM_Name("off", "Off"),
+									   PRM_Name("stitch", "Stitch Elements Into Host"),
+									   PRM_Name("cap", "Cap Element and Panel Bases"),
+									   PRM_Name(0) };
+static PRM_ChoiceList watertight_list(PRM_CHOICELIST_SINGLE, watertight_modes);
+
+static PRM_Item elem_shapes[] = { PRM_Item("stripev", "StripeV", "hr_stripe1"),
+								  PRM_Item("stripev2", "StripeV2", "hr_stripe2"),
+								  PRM_Item("stripev3", "StripeV3", "hr_stripe3"), 
+								  PRM_Item("tshape", "TShape", "hr_tshape"), 
+								  PRM_Item("rshape", "RShape", "hr_rshape"), 
+								  PRM_Item("square", "Square", "hr_square"), 
+								  PRM_Item(),};
+
+static PRM_ChoiceList elem_shapes_list(PRM_CHOICELIST_TOGGLE, elem_shapes);
+static_assert(sizeof(elem_shapes) / sizeof(PRM_Item) == NUM_SELECTABLE_SHAPES + 1, "Element Shapes menu and generator shape bits differ");
+
+static PRM_Name output_modes[] = { PRM_Name("polygons", "Polygons"),
+								   PRM_Name("packed", "Packed Primitives"),
+								   PRM_Name("points", "Instance Points"),
+								   PRM_Name("triangles", "Triangle Mesh"),
+								   PRM_Name(0) };
+static PRM_ChoiceList output_mode_list(PRM_CHOICELIST_SINGLE, output_modes);
+
+PRM_Template SOP_Hreeble::myparms[] = {
+	PRM_Template(PRM_STRING, 1, &prm_names[7], 0, &SOP_Node::primGroupMenu, 0, 0, SOP_Node::getGroupSelectButton(GA_GROUP_PRIMITIVE)),
+	PRM_Template(PRM_INT, 1, &PRMseedName, &seed_def, 0, &seed_range), /*seed*/
+	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[6], PRMoneDefaults), /*generate panels*/
+	PRM_Template(PRM_FLT, 1, &prm_names[1], &inset_def), /*inset*/
+	PRM_Template(PRM_FLT, 2, &prm_names[0], panel_height_def, 0, &panel_height_range), /*height*/
+	PRM_Template(PRM_INT, 1, &prm_names[2], PRMoneDefaults, 0, &elem_density_range), /*element density*/
+	PRM_Template(PRM_FLT, 2, &prm_names[3], elem_scale_def, 0, &elem_scale_range), /*element scale*/
+	PRM_Template(PRM_FLT, 2, &prm_names[4], elem_height_def, 0, &elem_height_range), /*element height*/
+	PRM_Template(PRM_ICONSTRIP, 1 , &prm_names[5], &elem_shapes_def, &elem_shapes_list),
+	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[9], PRMoneDefaults), /*convex geometry*/
+	PRM_Template(PRM_TOGGLE_E, 1 , &prm_names[8], PRMzeroDefaults), /*create groups*/
+	PRM_Template(PRM_TOGGLE_E, 1 , &prm_names[10], PRMzeroDefaults), /*auto generate uv*/
+	PRM_Template(PRM_TOGGLE_E, 1 , &prm_names[11], PRMoneDefaults), /*inherit source prim attribs*/
+	PRM_Template(PRM_ORD, 1, &prm_names[12], PRMzeroDefaults, &output_mode_list), /*element output mode*/
+	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[13], PRMzeroDefaults), /*chunked cook*/
+	PRM_Template(PRM_INT, 1, &prm_names[14], &chunk_size_def, 0, &chunk_size_range), /*source prims per chunk*/
+	PRM_Template(PRM_FLT, 1, &prm_names[15], PRMzeroDefaults, 0, &memory_budget_range), /*memory budget per chunk, 0 is unlimited*/
+	PRM_Template(PRM_ORD, 1, &prm_names[16], PRMzeroDefaults, &lod_mode_list), /*lod mode*/
+	PRM_Template(PRM_XYZ_J, 3, &prm_names[17], PRMzeroDefaults), /*lod reference camera*/
+	PRM_Template(PRM_FLT, 1, &prm_names[18], &lod_cap_size_def, 0, &lod_size_range), /*drop side walls below this size*/
+	PRM_Template(PRM_FLT, 1, &prm_names[19], &lod_cull_size_def, 0, &lod_size_range), /*skip elements below this size*/
+	PRM_Template(PRM_FILE, 1, &prm_names[20], PRMzeroDefaults), /*svg or json shape library*/
+	PRM_Template(PRM_STRING, 1, &prm_names[21], &library_shapes_def), /*library shape name pattern*/
+	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[22], PRMzeroDefaults), /*emit caps as cached triangles*/
+	PRM_Template(PRM_FLT, 1, &prm_names[23], PRMzeroDefaults, 0, &bevel_range), /*element bevel, fraction of element height*/
+	PRM_Template(PRM_FLT, 1, &prm_names[24], PRMzeroDefaults, 0, &bevel_range), /*panel bevel, fraction of panel height*/
+	PRM_Template(PRM_ORD, 1, &prm_names[25], PRMzeroDefaults, &bevel_shape_list), /*bevel profile shape*/
+	PRM_Template(PRM_INT, 1, &prm_names[26], PRMoneDefaults, 0, &bevel_segments_range), /*bevel profile segments*/
+	PRM_Template(PRM_INT, 1, &prm_names[27], PRMoneDefaults, 0, &elem_tiers_range), /*element layers stacked on caps*/
+	PRM_Template(PRM_FLT, 1, &prm_names[28], &tier_falloff_def, 0, &PRMunitRange), /*element height multiplier per tier*/
+	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[29], PRMzeroDefaults), /*pack element uvs into their own tile*/
+	PRM_Template(PRM_INT, 1, &prm_names[30], PRMoneDefaults, 0, &uv_tile_range), /*u offset of the element uv tile*/
+	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[31], PRMzeroDefaults), /*vertex N and tangentu*/
+	PRM_Template(PRM_ORD, 1, &prm_names[32], PRMzeroDefaults, &watertight_list), /*close or stitch element bases*/
+	PRM_Template(PRM_FILE, 1, &prm_names[33], PRMzeroDefaults), /*binary mesh written by triangle output*/
+	PRM_Template(PRM_TOGGLE_E, 1, &prm_names[34], PRMzeroDefaults), /*generate on a worker thread, preview meanwhile*/
+	PRM_Template(PRM_FLT, 1, &prm_names[35], PRMzeroDefaults, 0, &preview_faces_range), /*faces fully greebled in the preview, 0 is panels only*/
+	PRM_Template(PRM_CALLBACK, 1, &prm_names[36], 0, 0, 0, fetch_background_result), /*recook to show the finished result*/
+	PRM_Template(PRM_FILE, 1, &prm_names[37], PRMzeroDefaults), /*directory of cached results, empty is off*/
+	PRM_Template()
+};
+
+bool SOP_Hreeble::updateParmsFlags() {
+	bool changed = SOP_Node::updateParmsFlags();
+	uint generate_pannels = GeneratePanelsPRM();
+	uint elem_shapes = SelectedShapesPRM();
+	changed |= enableParm("panel_height", generate_pannels);
+	changed |= enableParm("panel_inset", generate_pannels);
+	changed |= enableParm("elem_density", elem_shapes);
+	changed |= enableParm("elem_scale", elem_shapes);
+	changed |= enableParm("elem_height", elem_shapes);
+	changed |= enableParm("elem_groups", elem_shapes);
+	changed |= enableParm("output_mode", elem_shapes);
+	uint chunked = ChunkedCookPRM();
+	changed |= enableParm("chunk_size", chunked);
+	changed |= enableParm("memory_budget", chunked);
+	LODModes lod = LODModePRM();
+	changed |= enableParm("lod_camera", lod == LODModes::CAMERA);
+	changed |= enableParm("lod_cap_size", lod != LODModes::OFF);
+	changed |= enableParm("lod_cull_size", lod != LODModes::OFF);
+	UT_String library_path;
+	ShapeLibraryPRM(library_path, 0.0);
+	changed |= enableParm("library_shapes", library_path.isstring());
+	changed |= enableParm("panel_bevel", generate_pannels);
+	changed |= enableParm("uv_tile", PackUVsPRM());
+	OutputModes output = OutputModePRM();
+	bool polygons = output == OutputModes::POLYGONS || output == OutputModes::TRIANGLES;
+	changed |= enableParm("elem_tiers", elem_shapes && polygons);
+	changed |= enableParm("tier_falloff", elem_shapes && polygons && ElemTiersPRM() > 1);
+	changed |= enableParm("watertight", polygons);
+	changed |= enableParm("cap_triangles", output != OutputModes::TRIANGLES);
+	changed |= enableParm("mesh_file", output == OutputModes::TRIANGLES);
+	bool bevels = ElemBevelPRM() > 0.0 || (generate_pannels != 0 && PanelBevelPRM() > 0.0);
+	changed |= enableParm("bevel_shape", bevels);
+	changed |= enableParm("bevel_segments", bevels);
+	uint async_cook = AsyncCookPRM();
+	changed |= enableParm("preview_faces", async_cook);
+	changed |= enableParm("fetch_result", async_cook);
+	return changed;
+}
+
+void newSopOperator(OP_OperatorTable *table) {
+	table->addOperator(new OP_Operator(
+		"hreeble",
+		"Hreeble",
+		SOP_Hreeble::creator,
+		SOP_Hreeble::myparms,
+		1,
+		1));
+}
+
+SOP_Hreeble::SOP_Hreeble(OP_Network * net, const char * name, OP_Operator * op):
+	SOP_Node(net, name, op), source_prim_group(nullptr)
+{
+	//flags().timeDep = 1;
+}
+
+SOP_Hreeble::~SOP_Hreeble() { }
+
+OP_Node * SOP_Hreeble::creator(OP_Network *net, const char *name, OP_Operator *op)
+{
+	return new SOP_Hreeble(net, name, op);
+}
+
+OP_ERROR SOP_Hreeble::cookInputGroups(OP_Context & ctx, int alone)
+{
+	return cookInputPrimitiveGroups(ctx, source_prim_group, alone);
+}
+
+OP_ERROR SOP_Hreeble::cookMySop(OP_Context & ctx)
+{
+	fpreal time = ctx.getTime();
+	GeneratorParms parms;
+	parms.seed = SeedPRM();
+	parms.generate_panels = GeneratePanelsPRM();
+	parms.panel_inset = PanelInsetPRM();
+	PanelHeightPRM(parms.panel_height, time);
+	parms.elem_density = ElemDensityPRM();
+	ElemScalePRM(parms.elem_scale, time);
+	ElemHeightPRM(parms.elem_height, time);
+	parms.shapes = SelectedShapesPRM();
+	parms.convex = DoConvexPRM();
+	parms.create_groups = CreateGroupsPRM();
+	parms.unwrap_uvs = UnwrapUVsPRM();
+	parms.inherit_attribs = InheritAttribsPRM();
+	parms.output_mode = OutputModePRM();
+	parms.chunked_cook = ChunkedCookPRM();
+	parms.chunk_size = ChunkSizePRM();
+	parms.memory_budget = MemoryBudgetPRM();
+	parms.lod_mode = LODModePRM();
+	fpreal64 lod_camera_parm[3];
+	LODCameraPRM(lod_camera_parm, time);
+	parms.lod_camera = UT_Vector3(lod_camera_parm[0], lod_camera_parm[1], lod_camera_parm[2]);
+	parms.lod_cap_size = LODCapSizePRM();
+	parms.lod_cull_size = LODCullSizePRM();
+	UT_String library_path, library_pattern, mesh_path;
+	ShapeLibraryPRM(library_path, time);
+	LibraryShapesPRM(library_pattern, time);
+	MeshFilePRM(mesh_path, time);
+	parms.shape_library = library_path.isstring() ? library_path.buffer() : "";
+	parms.library_shapes = library_pattern.isstring() ? library_pattern.buffer() : "";
+	parms.mesh_file = mesh_path.isstring() ? mesh_path.buffer() : "";
+	parms.cap_triangles = CapTrianglesPRM();
+	parms.elem_bevel = ElemBevelPRM();
+	parms.panel_bevel = PanelBevelPRM();
+	parms.bevel_shape = BevelShapePRM();
+	parms.bevel_segments = BevelSegmentsPRM();
+	parms.elem_tiers = ElemTiersPRM();
+	parms.tier_falloff = TierFalloffPRM();
+	parms.pack_uvs = PackUVsPRM();
+	parms.uv_tile = UVTilePRM();
+	parms.output_normals = OutputNormalsPRM();
+	parms.watertight = WatertightPRM();
+
+	OP_AutoLockInputs inputs(this);
+	if (error() > UT_ERROR_ABORT 
+		|| inputs.lock(ctx) >= UT_ERROR_ABORT
+		|| cookInputGroups(ctx) > UT_ERROR_ABORT 
+		|| (source_prim_group && source_prim_group->isEmpty()))
+		return error();
+
+	gdp->clearAndDestroy();
+	duplicateSource(0, ctx);
+	auto report = [&](const GeneratorResult &result, const UT_String &error_msg, const UT_String &warning_msg) {
+		if (result == GeneratorResult::FAILED)
+			addError(SOP_MESSAGE, error_msg);
+		else if (result == GeneratorResult::INTERRUPTED) {
+			// Partially built geometry is unusable, roll back to the untouched input
+			gdp->clearAndDestroy();
+			duplicateSource(0, ctx);
+			addWarning(SOP_MESSAGE, "Hreeble cook was interrupted, passing input through");
+		}
+		else if (warning_msg.isstring())
+			addWarning(SOP_MESSAGE, warning_msg);
+	};
+	const GU_Detail *input = inputGeo(0, ctx);
+	UT_String source_groups, cache_dir;
+	SourceGroupsPRM(source_groups);
+	CacheDirPRM(cache_dir, time);
+	uint async_cook = AsyncCookPRM();
+	// Only faces whose data changed are hashed again
+	uint64 input_hash = 0;
+	if (cache_dir.isstring() || async_cook) {
+		UT_Array<const GA_Attribute*> face_attribs;
+		Generator::face_attribs(input, parms, face_attribs);
+		input_hashes.update(input, face_attribs);
+		input_hash = input_hashes.detail();
+	}
+	uint64 cache_key = 0;
+	if (cache_dir.isstring()) {
+		cache_key = disk_cache.key(input_hash, source_groups.isstring() ? source_groups.buffer() : "", parms);
+		if (disk_cache.load(cache_dir, cache_key, gdp)) {
+			background.cancel();
+			// Generation writes the mesh file, so does a hit
+			UT_String mesh_error;
+			if (parms.output_mode == OutputModes::TRIANGLES && !parms.mesh_file.empty()
+				&& !hreeble::write_mesh(gdp, parms.mesh_file.c_str(), mesh_error))
+				addWarning(SOP_MESSAGE, mesh_error);
+			return error();
+		}
+	}
+	auto store = [&](const GeneratorResult &result) {
+		UT_String store_error;
+		if (cache_dir.isstring() && result == GeneratorResult::DONE && !disk_cache.store(cache_dir, cache_key, gdp, store_error))
+			addWarning(SOP_MESSAGE, store_error);
+	};
+	if (async_cook == 0) {
+		background.cancel();
+		GeneratorResult result = generator.generate(gdp, source_prim_group, parms);
+		report(result, generator.error(), generator.warning());
+		store(result);
+		return error();
+	}
+
+	// Parameter or input changes restart the worker, an unchanged cook keeps it running
+	CookKey key = { parms, source_groups.isstring() ? source_groups.buffer() : "", input_hash };
+	GeneratorResult result;
+	UT_String error_msg, warning_msg;
+	if (background.fetch(key, gdp, result, error_msg, warning_msg)) {
+		report(result, error_msg, warning_msg);
+		store(result);
+		return error();
+	}
+	if (!background.busy(key))
+		background.start(*gdp, source_prim_group, key);
+
+	// Panels only, or the first faces greebled in full
+	GeneratorParms preview = parms;
+	preview.mesh_file.clear();
+	fpreal preview_faces = PreviewFacesPRM();
+	GA_PrimitiveGroup *preview_group = nullptr;
+	if (preview_faces <= 0.0) {
+		preview.shapes = 0;
+		preview.shape_library.clear();
+	}
+	else {
+		exint num_faces = source_prim_group ? source_prim_group->entries() : gdp->getNumPrimitives();
+		exint num_preview = exint(SYSceil(num_faces * preview_faces / 100.0));
+		preview_group = gdp->newPrimitiveGroup("__hreeble_preview");
+		for (GA_Iterator it(gdp->getPrimitiveRange(source_prim_group)); !it.atEnd() && preview_group->entries() < num_preview; ++it)
+			preview_group->addOffset(*it);
+	}
+	result = generator.generate(gdp, preview_group ? preview_group : source_prim_group, preview);
+	if (preview_group)
+		gdp->destroyPrimitiveGroup(preview_group);
+	report(result, generator.error(), generator.warning());
+	addMessage(SOP_MESSAGE, "Showing a preview, press Fetch Background Result once the full cook is done");
+	return error();
+}